@@ -29,12 +29,210 @@
 #include <sys/epoll.h>
 #include <string.h>
 #include <errno.h>
-#include <sys/time.h>
-
-//Remove
-#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/eventfd.h>
 
 #include "backend_event_loop.h"
+#ifdef IO_URING_SUPPORT
+    #include "backend_event_loop_uring.h"
+#endif
+
+uint64_t backend_time_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000ULL) + (ts.tv_nsec / 1000);
+}
+
+static void backend_stats_add(struct backend_cb_stats *stats, uint64_t us)
+{
+    uint32_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+    if (bucket >= BACKEND_HIST_BUCKETS)
+        bucket = BACKEND_HIST_BUCKETS - 1;
+
+    stats->calls++;
+    stats->total_us += us;
+    stats->hist[bucket]++;
+
+    if (us > stats->max_us)
+        stats->max_us = us;
+}
+
+static void backend_stats_dump(backend_stats_line_cb cb, void *ptr,
+                               const char *type, const char *name,
+                               const struct backend_cb_stats *stats)
+{
+    char line[BACKEND_STATS_LINE_LEN];
+    size_t len;
+    uint32_t i;
+
+    if (!stats->calls)
+        return;
+
+    len = snprintf(line, sizeof(line), "  %s %s: calls %llu avg %lluus max "
+            "%lluus |", type, name ? name : "(unnamed)",
+            (unsigned long long) stats->calls,
+            (unsigned long long) (stats->total_us / stats->calls),
+            (unsigned long long) stats->max_us);
+
+    for (i = 0; i < BACKEND_HIST_BUCKETS && len < sizeof(line); i++) {
+        if (stats->hist[i])
+            len += snprintf(line + len, sizeof(line) - len, " <%lluus:%u",
+                    1ULL << i, stats->hist[i]);
+    }
+
+    cb(ptr, line);
+}
+
+void backend_event_loop_dump_stats(struct backend_event_loop *del,
+        const char *name, backend_stats_line_cb cb, void *ptr)
+{
+    struct backend_epoll_handle *handle;
+    struct backend_timeout_handle *timeout;
+    struct backend_task *task;
+    uint64_t run_time = backend_time_ms() - del->stats.start_ms;
+    char line[BACKEND_STATS_LINE_LEN];
+
+    snprintf(line, sizeof(line), "Event loop %s (%s): waits %llu events %llu "
+            "full batches %llu wakeups %llu (%.2f/s)", name,
+            backend_event_loop_uses_uring(del) ? "io_uring" : "epoll",
+            (unsigned long long) del->stats.waits,
+            (unsigned long long) del->stats.events,
+            (unsigned long long) del->stats.full_batches,
+            (unsigned long long) del->stats.wakeups,
+            run_time ? (del->stats.wakeups * 1000.0) / run_time : 0.0);
+    cb(ptr, line);
+
+    if (del->stats.spins) {
+        snprintf(line, sizeof(line), "  busy poll: spins %llu hits %llu "
+                "(%.1f%%)", (unsigned long long) del->stats.spins,
+                (unsigned long long) del->stats.spin_hits,
+                (del->stats.spin_hits * 100.0) / del->stats.spins);
+        cb(ptr, line);
+    }
+
+    LIST_FOREACH(handle, &(del->handles), handle_next)
+        backend_stats_dump(cb, ptr, "fd", handle->name, &(handle->stats));
+
+    LIST_FOREACH(timeout, &(del->timers), timer_next) {
+        backend_stats_dump(cb, ptr, "timer", timeout->name, &(timeout->stats));
+        backend_stats_dump(cb, ptr, "late", timeout->name,
+                &(timeout->lateness));
+    }
+
+    LIST_FOREACH(task, &(del->tasks), registry_next)
+        backend_stats_dump(cb, ptr, "task", task->name, &(task->stats));
+}
+
+static void backend_mailbox_push(struct backend_mailbox *mailbox,
+                                 struct backend_msg *msg)
+{
+    struct backend_msg *prev;
+
+    __atomic_store_n(&(msg->next), NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&(mailbox->head), msg, __ATOMIC_ACQ_REL);
+    //Queue is inconsistent until this store, pop() will treat it as empty
+    __atomic_store_n(&(prev->next), msg, __ATOMIC_RELEASE);
+}
+
+static struct backend_msg* backend_mailbox_pop(struct backend_mailbox *mailbox)
+{
+    struct backend_msg *tail = mailbox->tail;
+    struct backend_msg *next = __atomic_load_n(&(tail->next), __ATOMIC_ACQUIRE);
+
+    if (tail == &(mailbox->stub)) {
+        if (next == NULL)
+            return NULL;
+
+        mailbox->tail = next;
+        tail = next;
+        next = __atomic_load_n(&(tail->next), __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        mailbox->tail = next;
+        return tail;
+    }
+
+    //A producer is between exchange and store. It writes to the eventfd after
+    //the store, so we will be woken up again
+    if (tail != __atomic_load_n(&(mailbox->head), __ATOMIC_ACQUIRE))
+        return NULL;
+
+    //tail is the last message, put the stub back so that tail can be returned
+    backend_mailbox_push(mailbox, &(mailbox->stub));
+    next = __atomic_load_n(&(tail->next), __ATOMIC_ACQUIRE);
+
+    if (next != NULL) {
+        mailbox->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+static void backend_mailbox_handle(void *ptr, int32_t fd, uint32_t events)
+{
+    struct backend_mailbox *mailbox = ptr;
+    struct backend_msg *msg;
+    uint64_t num_posts;
+
+    //Value is not interesting, read is only to reset the counter
+    if (read(fd, &num_posts, sizeof(num_posts)) < 0 && errno != EAGAIN)
+        return;
+
+    while ((msg = backend_mailbox_pop(mailbox)) != NULL) {
+        msg->cb(msg->data);
+        free(msg);
+    }
+}
+
+int32_t backend_event_loop_post(struct backend_event_loop *del,
+        backend_msg_cb cb, void *data)
+{
+    struct backend_msg *msg = malloc(sizeof(struct backend_msg));
+    uint64_t wakeup = 1;
+
+    if (!msg)
+        return -1;
+
+    msg->cb = cb;
+    msg->data = data;
+    backend_mailbox_push(&(del->mailbox), msg);
+
+    if (write(del->mailbox.efd, &wakeup, sizeof(wakeup)) < 0 &&
+        errno != EAGAIN)
+        return -1;
+
+    return 0;
+}
+
+static int32_t backend_mailbox_init(struct backend_event_loop *del)
+{
+    struct backend_mailbox *mailbox = &(del->mailbox);
+
+    mailbox->stub.next = NULL;
+    mailbox->head = &(mailbox->stub);
+    mailbox->tail = &(mailbox->stub);
+
+    if ((mailbox->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        return -1;
+
+    backend_configure_epoll_handle(&(mailbox->handle), mailbox, mailbox->efd,
+            backend_mailbox_handle);
+    mailbox->handle.name = "mailbox";
+
+    if (backend_event_loop_update(del, EPOLLIN, EPOLL_CTL_ADD, mailbox->efd,
+                &(mailbox->handle))) {
+        close(mailbox->efd);
+        return -1;
+    }
+
+    return 0;
+}
 
 struct backend_event_loop* backend_event_loop_create()
 {
@@ -48,11 +246,63 @@ struct backend_event_loop* backend_event_loop_create()
         return NULL;
     }
 
-    LIST_INIT(&(del->timeout_list));
+    del->max_events = MAX_EPOLL_EVENTS;
+    del->stats.start_ms = backend_time_ms();
+    del->events = calloc(del->max_events, sizeof(struct epoll_event));
+
+    if (!del->events) {
+        close(del->efd);
+        free(del);
+        return NULL;
+    }
+
+    del->timeout_heap_size = BACKEND_TIMEOUT_HEAP_SIZE;
+    del->timeout_heap = calloc(del->timeout_heap_size,
+            sizeof(struct backend_timeout_handle*));
+
+    LIST_INIT(&(del->handles));
+    LIST_INIT(&(del->timers));
+    LIST_INIT(&(del->tasks));
+    TAILQ_INIT(&(del->next_tasks));
+    TAILQ_INIT(&(del->idle_tasks));
+
+#ifdef IO_URING_SUPPORT
+    //epoll is kept as fallback, io_uring might be missing or disabled
+    backend_uring_init(del);
+#endif
+
+    if (!del->timeout_heap || backend_mailbox_init(del)) {
+        close(del->efd);
+        free(del->timeout_heap);
+        free(del->events);
+        free(del);
+        return NULL;
+    }
 
     return del;
 }
 
+int32_t backend_event_loop_configure(struct backend_event_loop *del,
+        uint32_t max_events, uint8_t edge_triggered)
+{
+    struct epoll_event *events;
+
+    if (!max_events)
+        return -1;
+
+    if (max_events != del->max_events) {
+        if (!(events = calloc(max_events, sizeof(struct epoll_event))))
+            return -1;
+
+        free(del->events);
+        del->events = events;
+        del->max_events = max_events;
+    }
+
+    del->edge_triggered = edge_triggered;
+    return 0;
+}
+
 void backend_configure_epoll_handle(struct backend_epoll_handle *handle,
 		void *ptr, int fd, backend_epoll_cb cb)
 {
@@ -75,42 +325,181 @@ struct backend_epoll_handle* backend_create_epoll_handle(
 int32_t backend_event_loop_update(struct backend_event_loop *del, uint32_t events,
         int32_t op, int32_t fd, void *ptr)
 {
+    struct backend_epoll_handle *handle = ptr;
     struct epoll_event ev;
 
+    if (!del->edge_triggered)
+        events &= ~EPOLLET;
+
+    //Keep track of handles so that stats can be dumped, handles are re-added
+    //when for example a socket is reconnected
+    if (op == EPOLL_CTL_ADD && !handle->registered) {
+        LIST_INSERT_HEAD(&(del->handles), handle, handle_next);
+        handle->registered = 1;
+    }
+
+#ifdef IO_URING_SUPPORT
+    if (del->ring)
+        return backend_uring_update(del, events, op, fd, handle);
+#endif
+
     ev.events = events;
     ev.data.ptr = ptr;
 
     return epoll_ctl(del->efd, op, fd, &ev);
-} 
+}
+
+uint8_t backend_event_loop_uses_uring(struct backend_event_loop *del)
+{
+#ifdef IO_URING_SUPPORT
+    return del->ring != NULL;
+#else
+    return 0;
+#endif
+}
 
-void backend_insert_timeout(struct backend_event_loop *del,
-                            struct backend_timeout_handle *handle)
+static int32_t backend_event_loop_wait(struct backend_event_loop *del,
+                                       int32_t sleep_time)
 {
-    struct backend_timeout_handle *itr = del->timeout_list.lh_first, *prev_itr;
+#ifdef IO_URING_SUPPORT
+    if (del->ring)
+        return backend_uring_wait(del, sleep_time);
+#endif
 
-    if (itr == NULL ||
-        handle->timeout_clock < itr->timeout_clock) {
-        LIST_INSERT_HEAD(&(del->timeout_list), handle, timeout_next);
-        return;
-    } 
+    return epoll_wait(del->efd, del->events, del->max_events, sleep_time);
+}
+
+uint64_t backend_time_ms()
+{
+    struct timespec ts;
 
-    //Move to a separate insert function
-    for (; itr != NULL; itr = itr->timeout_next.le_next) {
-        if (handle->timeout_clock < itr->timeout_clock)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000ULL) + (ts.tv_nsec / 1000000);
+}
+
+static inline void backend_heap_set(struct backend_event_loop *del,
+                                    uint32_t idx,
+                                    struct backend_timeout_handle *handle)
+{
+    del->timeout_heap[idx] = handle;
+    handle->heap_idx = idx;
+}
+
+static void backend_heap_sift_up(struct backend_event_loop *del, uint32_t idx)
+{
+    struct backend_timeout_handle *handle = del->timeout_heap[idx];
+    uint32_t parent;
+
+    while (idx) {
+        parent = (idx - 1) / 2;
+
+        if (del->timeout_heap[parent]->expires <= handle->expires)
             break;
 
-        prev_itr = itr;
+        backend_heap_set(del, idx, del->timeout_heap[parent]);
+        idx = parent;
     }
 
-    LIST_INSERT_AFTER(prev_itr, handle, timeout_next);
+    backend_heap_set(del, idx, handle);
+}
+
+static void backend_heap_sift_down(struct backend_event_loop *del, uint32_t idx)
+{
+    struct backend_timeout_handle *handle = del->timeout_heap[idx];
+    uint32_t child;
+
+    while ((child = (2 * idx) + 1) < del->timeout_heap_len) {
+        if (child + 1 < del->timeout_heap_len &&
+            del->timeout_heap[child + 1]->expires <
+            del->timeout_heap[child]->expires)
+            child++;
+
+        if (handle->expires <= del->timeout_heap[child]->expires)
+            break;
+
+        backend_heap_set(del, idx, del->timeout_heap[child]);
+        idx = child;
+    }
+
+    backend_heap_set(del, idx, handle);
+}
+
+static void backend_heap_remove(struct backend_event_loop *del, uint32_t idx)
+{
+    struct backend_timeout_handle *last;
+
+    last = del->timeout_heap[--del->timeout_heap_len];
+
+    if (idx == del->timeout_heap_len)
+        return;
+
+    //Move last element into the hole, it can go either way
+    backend_heap_set(del, idx, last);
+    backend_heap_sift_down(del, idx);
+    backend_heap_sift_up(del, last->heap_idx);
+}
+
+//Round timeout_clock up to the value in [timeout_clock, timeout_clock + slack]
+//with the most trailing zero bits. Everything above the highest bit that
+//differs between the two ends is shared, so keep that and set the differing
+//bit
+static uint64_t backend_apply_slack(uint64_t timeout_clock, uint32_t slack)
+{
+    uint64_t limit = timeout_clock + slack, mask;
+
+    if (!slack)
+        return timeout_clock;
+
+    mask = (1ULL << (63 - __builtin_clzll(timeout_clock ^ limit))) - 1;
+
+    return limit & ~mask;
+}
+
+int32_t backend_insert_timeout(struct backend_event_loop *del,
+                               struct backend_timeout_handle *handle)
+{
+    struct backend_timeout_handle **heap;
+
+    if (handle->state == BACKEND_TIMEOUT_SCHEDULED)
+        backend_heap_remove(handle->del, handle->heap_idx);
+
+    if (del->timeout_heap_len == del->timeout_heap_size) {
+        heap = realloc(del->timeout_heap, del->timeout_heap_size * 2 *
+                sizeof(struct backend_timeout_handle*));
+
+        if (!heap) {
+            handle->state = BACKEND_TIMEOUT_IDLE;
+            return -1;
+        }
+
+        del->timeout_heap = heap;
+        del->timeout_heap_size *= 2;
+    }
+
+    if (handle->registered != del) {
+        if (handle->registered)
+            LIST_REMOVE(handle, timer_next);
+
+        LIST_INSERT_HEAD(&(del->timers), handle, timer_next);
+        handle->registered = del;
+    }
+
+    handle->del = del;
+    handle->expires = backend_apply_slack(handle->timeout_clock, handle->slack);
+    handle->state = BACKEND_TIMEOUT_SCHEDULED;
+    backend_heap_set(del, del->timeout_heap_len++, handle);
+    backend_heap_sift_up(del, handle->heap_idx);
+
+    return 0;
 }
 
-//Added
 void backend_remove_timeout(struct backend_timeout_handle *timeout)
 {
-    LIST_REMOVE(timeout, timeout_next);
-    timeout->timeout_next.le_next = NULL;
-    timeout->timeout_next.le_prev = NULL;
+    //Removing a running timer only means that it will not be rearmed
+    if (timeout->state == BACKEND_TIMEOUT_SCHEDULED)
+        backend_heap_remove(timeout->del, timeout->heap_idx);
+
+    timeout->state = BACKEND_TIMEOUT_IDLE;
 }
 
 struct backend_timeout_handle* backend_event_loop_create_timeout(
@@ -133,32 +522,153 @@ struct backend_timeout_handle* backend_event_loop_create_timeout(
     return handle;
 }
 
+void backend_task_init(struct backend_task *task, backend_task_cb cb,
+        void *ptr, const char *name)
+{
+    memset(task, 0, sizeof(struct backend_task));
+    task->cb = cb;
+    task->data = ptr;
+    task->name = name;
+}
+
+void backend_schedule_task(struct backend_event_loop *del,
+        struct backend_task *task, uint8_t when)
+{
+    struct backend_task_list *queue = when == BACKEND_TASK_IDLE ?
+        &(del->idle_tasks) : &(del->next_tasks);
+
+    if (task->queue != NULL)
+        return;
+
+    if (task->registered != del) {
+        if (task->registered)
+            LIST_REMOVE(task, registry_next);
+
+        LIST_INSERT_HEAD(&(del->tasks), task, registry_next);
+        task->registered = del;
+    }
+
+    TAILQ_INSERT_TAIL(queue, task, task_next);
+    task->queue = queue;
+}
+
+void backend_cancel_task(struct backend_task *task)
+{
+    if (task->queue == NULL)
+        return;
+
+    TAILQ_REMOVE(task->queue, task, task_next);
+    task->queue = NULL;
+}
+
+static void backend_event_loop_run_tasks(struct backend_event_loop *del,
+        struct backend_task_list *queue)
+{
+    struct backend_task_list running;
+    struct backend_task *task;
+    uint64_t start_us;
+
+    if (TAILQ_EMPTY(queue))
+        return;
+
+    //Only run the tasks that are queued now, so that a task scheduling itself
+    //does not starve the rest of the loop
+    TAILQ_INIT(&running);
+    TAILQ_CONCAT(&running, queue, task_next);
+    TAILQ_FOREACH(task, &running, task_next)
+        task->queue = &running;
+
+    while ((task = TAILQ_FIRST(&running)) != NULL) {
+        TAILQ_REMOVE(&running, task, task_next);
+        task->queue = NULL;
+
+        start_us = backend_time_us();
+        task->cb(task->data);
+        backend_stats_add(&(task->stats), backend_time_us() - start_us);
+    }
+}
+
+int32_t backend_event_loop_busy_poll(struct backend_event_loop *del,
+        backend_poll_cb cb, void *ptr, uint32_t spin_us)
+{
+    if (del->busy_poll.cb != NULL)
+        return -1;
+
+    del->busy_poll.cb = cb;
+    del->busy_poll.data = ptr;
+    del->busy_poll.spin_us = spin_us;
+    return 0;
+}
+
+//Spin on the busy poll callback, and return how long the loop should block
+//afterwards. 0 if the callback found work, otherwise what is left of
+//sleep_time
+static int32_t backend_event_loop_spin(struct backend_event_loop *del,
+                                       int32_t sleep_time)
+{
+    uint64_t spin_us = del->busy_poll.spin_us, start_us, now_us;
+    uint32_t spun_ms;
+
+    //Don't spin past the next timer
+    if (sleep_time >= 0 && (uint64_t) sleep_time * 1000 < spin_us)
+        spin_us = (uint64_t) sleep_time * 1000;
+
+    del->stats.spins++;
+    start_us = backend_time_us();
+
+    do {
+        if (del->busy_poll.cb(del->busy_poll.data)) {
+            del->stats.spin_hits++;
+            return 0;
+        }
+
+        now_us = backend_time_us();
+    } while (now_us - start_us < spin_us);
+
+    if (sleep_time < 0)
+        return sleep_time;
+
+    spun_ms = (now_us - start_us) / 1000;
+    return spun_ms < (uint32_t) sleep_time ? sleep_time - spun_ms : 0;
+}
+
 static void backend_event_loop_run_timers(struct backend_event_loop *del)
 {
-    struct backend_timeout_handle *timeout = del->timeout_list.lh_first;
     struct backend_timeout_handle *cur_timeout;
-    struct timeval tv;
-    uint64_t cur_time;
+    uint64_t cur_time = backend_time_ms();
+    uint64_t start_us, late_us;
 
-    gettimeofday(&tv, NULL);
-    cur_time = (tv.tv_sec * 1e3) + (tv.tv_usec / 1e3);
+    while (del->timeout_heap_len) {
+        cur_timeout = del->timeout_heap[0];
 
-    while (timeout != NULL) {
-        if (timeout->timeout_clock <= cur_time) {
-            cur_timeout = timeout;
-            timeout = timeout->timeout_next.le_next;
+        //The next timer is also run if its window has started, this saves a
+        //wakeup when it would otherwise have been rounded to a later time
+        if (cur_timeout->expires > cur_time &&
+            cur_timeout->timeout_clock > cur_time)
+            break;
+
+        //Remove timer before executing callback, so that callback can insert
+        //or remove it
+        backend_heap_remove(del, 0);
+        cur_timeout->state = BACKEND_TIMEOUT_RUNNING;
+
+        start_us = backend_time_us();
+        late_us = cur_timeout->timeout_clock * 1000;
+        late_us = start_us > late_us ? start_us - late_us : 0;
+        backend_stats_add(&(cur_timeout->lateness), late_us);
 
-            //Execute and remove timeout from list
-            cur_timeout->cb(cur_timeout->data);
-            backend_remove_timeout(cur_timeout);
+        cur_timeout->cb(cur_timeout->data);
+        backend_stats_add(&(cur_timeout->stats), backend_time_us() - start_us);
 
-            //Rearm timer if needed
-            if (cur_timeout->intvl) {
-                cur_timeout->timeout_clock = cur_time + cur_timeout->intvl;
-                backend_insert_timeout(del, cur_timeout);
-            }
+        if (cur_timeout->state != BACKEND_TIMEOUT_RUNNING)
+            continue;
+
+        //Rearm timer if needed
+        if (cur_timeout->intvl) {
+            cur_timeout->timeout_clock = cur_time + cur_timeout->intvl;
+            backend_insert_timeout(del, cur_timeout);
         } else {
-            break;
+            cur_timeout->state = BACKEND_TIMEOUT_IDLE;
         }
     }
 }
@@ -166,32 +676,48 @@ static void backend_event_loop_run_timers(struct backend_event_loop *del)
 void backend_event_loop_run(struct backend_event_loop *del)
 {
     struct backend_epoll_handle *cur_handle = NULL;
-    struct epoll_event events[MAX_EPOLL_EVENTS];
     int nfds, i, sleep_time;
+    uint64_t start_us;
 
-    struct timeval tv;
     uint64_t cur_time;
     struct backend_timeout_handle *timeout;
 
     while(1){
-        timeout = del->timeout_list.lh_first;
-        gettimeofday(&tv, NULL);
-        cur_time = (tv.tv_sec * 1e3) + (tv.tv_usec / 1e3);
-       
+        timeout = del->timeout_heap_len ? del->timeout_heap[0] : NULL;
+        cur_time = backend_time_ms();
+
         if (timeout != NULL) {
-            if (cur_time > timeout->timeout_clock)
+            if (cur_time > timeout->expires)
                 sleep_time = 0;
             else
-                sleep_time = timeout->timeout_clock - cur_time;
+                sleep_time = timeout->expires - cur_time;
         } else {
             sleep_time = -1;
         }
 
-		nfds = epoll_wait(del->efd, events, MAX_EPOLL_EVENTS, sleep_time);
+        //Pending tasks are run after a non-blocking check for events
+        if (!TAILQ_EMPTY(&(del->next_tasks)) || !TAILQ_EMPTY(&(del->idle_tasks)))
+            sleep_time = 0;
+
+        //If the spin found work, still check the other fds before spinning
+        //again
+        if (sleep_time && del->busy_poll.cb != NULL)
+            sleep_time = backend_event_loop_spin(del, sleep_time);
+
+		nfds = backend_event_loop_wait(del, sleep_time);
 
 		if (nfds < 0)
 			continue;
 
+        del->stats.waits++;
+        del->stats.events += nfds;
+
+        if (sleep_time)
+            del->stats.wakeups++;
+
+        if ((uint32_t) nfds == del->max_events)
+            del->stats.full_batches++;
+
         //TODO: Make sure the order of processing is safe wrt event caching and
         //so on. I can't think of any problems right now, since we will not for
         //example free a device in the internal libusb_list. So a USB event will
@@ -204,11 +730,17 @@ void backend_event_loop_run(struct backend_event_loop *del)
             backend_event_loop_run_timers(del);
 
         for(i=0; i<nfds; i++) {
-            cur_handle = events[i].data.ptr;
-            cur_handle->cb(cur_handle->data, cur_handle->fd, events[i].events);
+            cur_handle = del->events[i].data.ptr;
+            start_us = backend_time_us();
+            cur_handle->cb(cur_handle->data, cur_handle->fd,
+                    del->events[i].events);
+            backend_stats_add(&(cur_handle->stats),
+                    backend_time_us() - start_us);
         }
 
-        if (del->itr_cb != NULL)
-            del->itr_cb(del->itr_data);
+        backend_event_loop_run_tasks(del, &(del->next_tasks));
+
+        if (!nfds)
+            backend_event_loop_run_tasks(del, &(del->idle_tasks));
     }
 }
@@ -27,10 +27,19 @@
 #ifndef BACKEND_EVENT_LOOP_H
 #define BACKEND_EVENT_LOOP_H
 
+#include <stdio.h>
+#include <stdint.h>
 #include <sys/queue.h>
 #include <sys/epoll.h>
 
+//Default number of events returned by one epoll_wait, see
+//backend_event_loop_configure()
 #define MAX_EPOLL_EVENTS 10
+//Initial number of timers the heap has room for, doubled when full
+#define BACKEND_TIMEOUT_HEAP_SIZE 16
+//Number of log2 buckets in the latency histograms. Bucket 0 is < 1us, bucket n
+//is [2^(n-1), 2^n) us, and the last bucket also contains everything above
+#define BACKEND_HIST_BUCKETS 24
 
 //Any resource used by the callback is stored in the implementing "class".
 //Assume one separate callback function per type of event
@@ -38,29 +47,165 @@
 //descriptors, for example netlink
 typedef void(*backend_epoll_cb)(void *ptr, int32_t fd, uint32_t events);
 typedef void(*backend_timeout_cb)(void *ptr);
-typedef backend_timeout_cb backend_itr_cb;
+typedef backend_timeout_cb backend_task_cb;
+typedef backend_timeout_cb backend_msg_cb;
+//Returns 1 if there was work to do (and it was done)
+typedef uint8_t(*backend_poll_cb)(void *ptr);
 
+//Time spent in a callback (or how late a timer was), in us
+struct backend_cb_stats {
+    uint64_t calls;
+    uint64_t total_us;
+    uint64_t max_us;
+    uint32_t hist[BACKEND_HIST_BUCKETS];
+};
+
+//name is optional and only used when dumping stats
 struct backend_epoll_handle{
     void *data;
     int32_t fd;
     backend_epoll_cb cb;
+    const char *name;
+    struct backend_cb_stats stats;
+    //All handles that have been added to a loop, for dumping stats
+    LIST_ENTRY(backend_epoll_handle) handle_next;
+    uint8_t registered;
+#ifdef IO_URING_SUPPORT
+    //fd and events the poll request was armed with (0 if removed), and number
+    //of poll requests that have not completed yet
+    int32_t uring_fd;
+    uint32_t uring_events;
+    uint8_t uring_armed;
+#endif
+};
+
+enum backend_timeout_state {
+    BACKEND_TIMEOUT_IDLE,
+    BACKEND_TIMEOUT_SCHEDULED,
+    //Callback is being executed
+    BACKEND_TIMEOUT_RUNNING,
 };
 
-//timeout_clock is first timeout in wallclock (ms), intvl is frequency after
-//that. Set to 0 if no repeat is needed
+//timeout_clock is first timeout in CLOCK_MONOTONIC (ms, see
+//backend_time_ms()), intvl is frequency after that. Set to 0 if no repeat is
+//needed. A timer is removed from the heap before the callback is called, so
+//the callback is free to re-insert or remove its own timer. intvl is read
+//after the callback, and the timer is only rearmed if the callback did not
+//insert or remove it.
+//
+//slack (ms) is how late the timer is allowed to fire. The expiry is rounded up
+//inside [timeout_clock, timeout_clock + slack], to the value with the most
+//trailing zero bits, so that timers with overlapping windows expire at the
+//same time. When the loop wakes up for one timer, it also runs the timers whose
+//window has started
 struct backend_timeout_handle{
     uint64_t timeout_clock;
+    //timeout_clock with slack applied, the heap is ordered on this
+    uint64_t expires;
     backend_timeout_cb cb;
-    LIST_ENTRY(backend_timeout_handle) timeout_next;
+    //Loop the timer was last inserted into, and position in its heap
+    struct backend_event_loop *del;
+    uint32_t heap_idx;
     uint32_t intvl;
+    uint32_t slack;
+    uint8_t state;
+    void *data;
+    const char *name;
+    struct backend_cb_stats stats;
+    //Time from timeout_clock until callback was called
+    struct backend_cb_stats lateness;
+    LIST_ENTRY(backend_timeout_handle) timer_next;
+    //Loop whose timer list this timer is on
+    struct backend_event_loop *registered;
+};
+
+//When a scheduled task is run, see backend_schedule_task()
+enum backend_task_when {
+    //After the callbacks of the current iteration, before the loop sleeps
+    BACKEND_TASK_NEXT,
+    //On the first iteration where epoll returns no events
+    BACKEND_TASK_IDLE,
+};
+
+TAILQ_HEAD(backend_task_list, backend_task);
+
+//Deferred work, scheduled by the owner only when there is something to do. A
+//task is run once per schedule, the callback can schedule it again
+struct backend_task {
+    backend_task_cb cb;
+    void *data;
+    const char *name;
+    struct backend_cb_stats stats;
+    TAILQ_ENTRY(backend_task) task_next;
+    //List the task is queued on, NULL when not scheduled
+    struct backend_task_list *queue;
+    LIST_ENTRY(backend_task) registry_next;
+    struct backend_event_loop *registered;
+};
+
+//Work posted to a loop from another thread, see backend_event_loop_post()
+struct backend_msg {
+    struct backend_msg *next;
+    backend_msg_cb cb;
+    void *data;
+};
+
+//Lock-free multi-producer, single-consumer queue of messages (intrusive
+//Vyukov queue). Producers only swap head, the loop owning the mailbox is the
+//only one touching tail. An eventfd wakes up the owning loop
+struct backend_mailbox {
+    struct backend_msg *head;
+    struct backend_msg *tail;
+    struct backend_msg stub;
+    struct backend_epoll_handle handle;
+    int32_t efd;
+};
+
+struct backend_event_loop_stats {
+    uint64_t waits;
+    //Waits that could block, i.e., no timer or task was already due. This is
+    //the number of times the thread went to sleep
+    uint64_t wakeups;
+    uint64_t events;
+    //Number of times epoll_wait returned max_events events, i.e., there were
+    //probably more events ready
+    uint64_t full_batches;
+    //When the loop was created (backend_time_ms())
+    uint64_t start_ms;
+    //Number of times the loop spun before blocking, and how many of those
+    //found work before spin_us had passed
+    uint64_t spins;
+    uint64_t spin_hits;
+};
+
+//See backend_event_loop_busy_poll()
+struct backend_busy_poll {
+    backend_poll_cb cb;
     void *data;
+    uint32_t spin_us;
 };
 
 struct backend_event_loop{
     int32_t efd;
-    LIST_HEAD(timeout, backend_timeout_handle) timeout_list;
-    backend_itr_cb itr_cb;
-    void *itr_data;
+#ifdef IO_URING_SUPPORT
+    //NULL if io_uring is not available, epoll is then used
+    struct io_uring *ring;
+#endif
+    struct epoll_event *events;
+    uint32_t max_events;
+    uint8_t edge_triggered;
+    struct backend_event_loop_stats stats;
+    LIST_HEAD(handles, backend_epoll_handle) handles;
+    LIST_HEAD(timers, backend_timeout_handle) timers;
+    LIST_HEAD(tasks, backend_task) tasks;
+    struct backend_task_list next_tasks;
+    struct backend_task_list idle_tasks;
+    struct backend_busy_poll busy_poll;
+    struct backend_mailbox mailbox;
+    //Binary min-heap of timers, ordered on expires
+    struct backend_timeout_handle **timeout_heap;
+    uint32_t timeout_heap_len;
+    uint32_t timeout_heap_size;
 };
 
 //Create an backend_event_loop struct
@@ -69,13 +214,45 @@ struct backend_event_loop{
 //backend_create_epoll_handle()
 struct backend_event_loop* backend_event_loop_create();
 
-//Update file descriptor + ptr to efd in events according to op
+//Set number of events returned by one epoll_wait and if EPOLLET is allowed.
+//Must be called before any file descriptor is added. Returns -1 on failure
+int32_t backend_event_loop_configure(struct backend_event_loop *del,
+        uint32_t max_events, uint8_t edge_triggered);
+
+//Run cb(data) on the thread running del. Safe to call from any thread, also
+//from the thread running del. Messages are executed in the order they were
+//posted (per producer). Returns -1 if the message could not be allocated or the
+//loop could not be woken up
+int32_t backend_event_loop_post(struct backend_event_loop *del,
+        backend_msg_cb cb, void *data);
+
+//Before blocking, call cb(ptr) in a loop for up to spin_us (or until the next
+//timer). If cb finds work, the loop does not block. This trades CPU for
+//latency, other fds are only checked after the spin. Only one busy poll
+//callback per loop, returns -1 if one is already set
+int32_t backend_event_loop_busy_poll(struct backend_event_loop *del,
+        backend_poll_cb cb, void *ptr, uint32_t spin_us);
+
+//Update file descriptor + ptr to efd in events according to op. Handlers that
+//always read until EAGAIN (or the equivalent, for example until ZMQ_EVENTS no
+//longer contains ZMQ_POLLIN) can pass EPOLLET. EPOLLET is removed unless edge
+//triggered mode has been enabled for the loop
 int32_t backend_event_loop_update(struct backend_event_loop *del, uint32_t events,
         int32_t op, int32_t fd, void *ptr);
 
-//Insert timeout into list, we need manual control of adding timeouts
-void backend_insert_timeout(struct backend_event_loop *del,
-                            struct backend_timeout_handle *handle);
+//Current value of CLOCK_MONOTONIC in ms. Use this for timeout_clock, the
+//wallclock can jump (NTP, GPS) and must not be used for timers
+uint64_t backend_time_ms();
+//Same as backend_time_ms(), but in us. Used for measuring short durations
+uint64_t backend_time_us();
+
+//Insert timeout into heap, we need manual control of adding timeouts. A timer
+//that is already scheduled is moved. O(log n). Returns -1 if the heap could not
+//be grown
+int32_t backend_insert_timeout(struct backend_event_loop *del,
+                               struct backend_timeout_handle *handle);
+//Remove timer from its loop. O(log n). Safe to call for a timer that is not
+//scheduled, and from the timer's own callback (the timer will not be rearmed)
 void backend_remove_timeout(struct backend_timeout_handle *timeout);
 
 //Add a timeout which is controlled by main loop
@@ -83,6 +260,19 @@ struct backend_timeout_handle* backend_event_loop_create_timeout(
         uint64_t timeout_clock, backend_timeout_cb timeout_cb, void *ptr,
         uint32_t intvl);
 
+//Fill task with cb and ptr. name is optional and only used for stats
+void backend_task_init(struct backend_task *task, backend_task_cb cb,
+        void *ptr, const char *name);
+
+//Queue task to be run on del, see enum backend_task_when. Scheduling a task
+//that is already queued does nothing. Tasks scheduled by a task are run on the
+//next iteration, and the loop will not sleep until they have run
+void backend_schedule_task(struct backend_event_loop *del,
+        struct backend_task *task, uint8_t when);
+
+//Remove task from queue. Safe to call for a task that is not scheduled
+void backend_cancel_task(struct backend_task *task);
+
 //Fill handle with ptr, fd, and cb. Used by create_epoll_handle and can be used
 //by applications that use a different allocater for handle
 void backend_configure_epoll_handle(struct backend_epoll_handle *handle,
@@ -92,6 +282,21 @@ void backend_configure_epoll_handle(struct backend_epoll_handle *handle,
 struct backend_epoll_handle* backend_create_epoll_handle(void *ptr, int fd,
         backend_epoll_cb cb);
 
+//Called once per line (without newline) of a stats dump
+typedef void (*backend_stats_line_cb)(void *ptr, const char *line);
+
+//Max length of one line of a stats dump, longer lines are truncated
+#define BACKEND_STATS_LINE_LEN 1024
+
+//Pass counters and latency histograms for all handles, timers and tasks of
+//the loop to cb, line by line. Must be called from the thread running the
+//loop, for example with backend_event_loop_post()
+void backend_event_loop_dump_stats(struct backend_event_loop *del,
+        const char *name, backend_stats_line_cb cb, void *ptr);
+
+//Returns 1 if del uses io_uring instead of epoll
+uint8_t backend_event_loop_uses_uring(struct backend_event_loop *del);
+
 //Run event loop described by efd. Let it be up to the user how efd shall be
 //stored
 //Function is for now never supposed to return. If it returns, something has
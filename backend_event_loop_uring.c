@@ -0,0 +1,185 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdlib.h>
+#include <errno.h>
+#include <liburing.h>
+
+#include "backend_event_loop.h"
+#include "backend_event_loop_uring.h"
+
+//Get a free SQE, submitting queued requests if the submission queue is full
+static struct io_uring_sqe* backend_uring_get_sqe(struct io_uring *ring)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+
+    if (sqe == NULL && io_uring_submit(ring) >= 0)
+        sqe = io_uring_get_sqe(ring);
+
+    return sqe;
+}
+
+static int32_t backend_uring_arm(struct io_uring *ring,
+        struct backend_epoll_handle *handle)
+{
+    struct io_uring_sqe *sqe = backend_uring_get_sqe(ring);
+
+    if (sqe == NULL)
+        return -1;
+
+    if (handle->uring_events & EPOLLET)
+        io_uring_prep_poll_multishot(sqe, handle->uring_fd,
+                handle->uring_events & ~EPOLLET);
+    else
+        io_uring_prep_poll_add(sqe, handle->uring_fd, handle->uring_events);
+
+    io_uring_sqe_set_data(sqe, handle);
+    handle->uring_armed++;
+    return 0;
+}
+
+static int32_t backend_uring_disarm(struct io_uring *ring,
+        struct backend_epoll_handle *handle)
+{
+    struct io_uring_sqe *sqe = backend_uring_get_sqe(ring);
+
+    if (sqe == NULL)
+        return -1;
+
+    //Completion of the remove request itself is ignored (no handle), the
+    //cancelled poll completes with -ECANCELED
+    io_uring_prep_poll_remove(sqe, (uint64_t) (uintptr_t) handle);
+    io_uring_sqe_set_data(sqe, NULL);
+    return 0;
+}
+
+int32_t backend_uring_init(struct backend_event_loop *del)
+{
+    struct io_uring_params params = {0};
+    struct io_uring *ring = calloc(sizeof(struct io_uring), 1);
+
+    if (ring == NULL)
+        return -1;
+
+    if (io_uring_queue_init_params(BACKEND_URING_ENTRIES, ring, &params)) {
+        free(ring);
+        return -1;
+    }
+
+    //Multishot poll was added in 5.13, the same release as RSRC_TAGS. There is
+    //no probe for poll flags, so use the feature flag to detect older kernels
+    if (!(params.features & IORING_FEAT_RSRC_TAGS)) {
+        io_uring_queue_exit(ring);
+        free(ring);
+        return -1;
+    }
+
+    del->ring = ring;
+    return 0;
+}
+
+int32_t backend_uring_update(struct backend_event_loop *del, uint32_t events,
+        int32_t op, int32_t fd, struct backend_epoll_handle *handle)
+{
+    //A handle can be re-added without EPOLL_CTL_DEL when the fd has been
+    //closed (epoll removes closed fds automatically, poll requests keep a
+    //reference to the file), so always get rid of the old request first
+    handle->uring_events = 0;
+
+    if (handle->uring_armed && backend_uring_disarm(del->ring, handle))
+        return -1;
+
+    if (op == EPOLL_CTL_DEL)
+        return 0;
+
+    handle->uring_fd = fd;
+    handle->uring_events = events;
+
+    return backend_uring_arm(del->ring, handle);
+}
+
+int32_t backend_uring_wait(struct backend_event_loop *del, int32_t sleep_time)
+{
+    struct io_uring *ring = del->ring;
+    struct io_uring_cqe *cqe;
+    struct __kernel_timespec ts, *tsp = NULL;
+    struct backend_epoll_handle *handle;
+    uint32_t head, seen = 0;
+    int32_t retval, nfds = 0;
+
+    if (sleep_time >= 0) {
+        ts.tv_sec = sleep_time / 1000;
+        ts.tv_nsec = (sleep_time % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    //Submits queued (re-)arm requests and waits in the same system call
+    retval = io_uring_submit_and_wait_timeout(ring, &cqe, 1, tsp, NULL);
+
+    if (retval < 0 && retval != -ETIME)
+        return -1;
+
+    io_uring_for_each_cqe(ring, head, cqe) {
+        if (nfds == (int32_t) del->max_events)
+            break;
+
+        seen++;
+        handle = io_uring_cqe_get_data(cqe);
+
+        //Completion of a remove request
+        if (handle == NULL)
+            continue;
+
+        //Single-shot polls are done after one completion, and the kernel can
+        //also terminate a multishot poll (for example on CQ overflow). Only
+        //re-arm when this was the last request for the handle, a request that
+        //completed before it was replaced must not lead to two armed polls.
+        //When a handle is re-added, the replaced request can be cancelled
+        //after the new one has completed, so a cancellation also re-arms if
+        //the handle is still in use. The new request is submitted on the next
+        //wait, i.e., after the callback has run. A failed poll is not re-armed,
+        //epoll would not report a bad fd either
+        if (!(cqe->flags & IORING_CQE_F_MORE) && !--handle->uring_armed &&
+            handle->uring_events &&
+            (cqe->res > 0 || cqe->res == -ECANCELED) &&
+            backend_uring_arm(ring, handle))
+            handle->uring_events = 0;
+
+        //Remove requests are not submitted until the next wait, so the poll
+        //can complete after the handle has been removed
+        if (cqe->res <= 0 || !handle->uring_events)
+            continue;
+
+        del->events[nfds].events = cqe->res;
+        del->events[nfds].data.ptr = handle;
+        nfds++;
+    }
+
+    io_uring_cq_advance(ring, seen);
+
+    return nfds;
+}
@@ -0,0 +1,62 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+struct backend_event_loop;
+struct backend_epoll_handle;
+
+//Number of submission queue entries per loop. The completion queue is twice
+//as large
+#define BACKEND_URING_ENTRIES 64
+
+//io_uring implementation of the fd part of backend_event_loop, used instead of
+//epoll when the kernel supports it. Timers still live in the loop's heap, the
+//nearest timeout is passed to the kernel together with the wait.
+//
+//Handles registered with EPOLLET use multishot poll, the kernel keeps the poll
+//armed and posts one completion per wakeup. All other handles use single-shot
+//poll, which is re-armed after the callback has run. This gives the same level
+//triggered behavior as epoll, the readiness check is done when the poll is
+//armed
+
+//Create ring for del. Returns -1 if io_uring is not available or too old, the
+//loop should then use epoll
+int32_t backend_uring_init(struct backend_event_loop *del);
+
+//Same semantics as epoll_ctl(). Requests are queued and submitted on the next
+//backend_uring_wait(). A removed handle must not be freed before the next
+//wait, the kernel still has a reference to it until the poll is cancelled
+int32_t backend_uring_update(struct backend_event_loop *del, uint32_t events,
+        int32_t op, int32_t fd, struct backend_epoll_handle *handle);
+
+//Submit queued requests and wait for at most sleep_time ms (-1 is forever).
+//Ready handles are stored in del->events, like epoll_wait(). Returns number of
+//events or -1 on error/interrupt
+int32_t backend_uring_wait(struct backend_event_loop *del, int32_t sleep_time);
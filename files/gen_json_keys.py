@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+#
+# Generate the perfect hash key table used by the streaming JSON parser
+# (metadata_json_keys.h/metadata_json_keys.c). Usage:
+#
+#   gen_json_keys.py <key list> <output directory>
+#
+# The key list contains one key per line, empty lines and lines starting with #
+# are ignored. Every key gets an id (MD_JSON_KEY_<KEY>), in the order of the
+# list.
+#
+# Keys are hashed with 32 bit FNV-1a, using a seed instead of the standard
+# offset basis, and the hash is folded into a power of two sized table. We
+# search for the smallest table and the first seed where no two keys collide,
+# so a lookup is one hash, one table read and one memcmp.
+
+import os
+import sys
+
+FNV_PRIME = 16777619
+MAX_SEEDS = 1 << 18
+
+HEADER = """/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//Generated by files/gen_json_keys.py from files/json_keys.txt, do not edit
+"""
+
+
+def read_keys(path):
+    keys = []
+
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+
+            if not line or line.startswith('#'):
+                continue
+
+            if line in keys:
+                sys.exit("Duplicate key %s" % line)
+
+            keys.append(line)
+
+    return keys
+
+
+def key_hash(key, seed, mask):
+    h = seed
+
+    for c in key.encode():
+        h = ((h ^ c) * FNV_PRIME) & 0xffffffff
+
+    return (h ^ (h >> 16)) & mask
+
+
+def find_seed(keys):
+    size = 1
+
+    while size < len(keys) * 4:
+        size <<= 1
+
+    while True:
+        for seed in range(MAX_SEEDS):
+            slots = set(key_hash(k, seed, size - 1) for k in keys)
+
+            if len(slots) == len(keys):
+                return size, seed
+
+        size <<= 1
+
+
+def write_header(path, keys, size, seed):
+    with open(path, 'w') as f:
+        f.write(HEADER)
+        f.write("\n#pragma once\n\n#include <stdint.h>\n#include <stddef.h>\n\n")
+        f.write("#define MD_JSON_KEY_TABLE_SIZE  %u\n" % size)
+        f.write("#define MD_JSON_KEY_SEED        0x%08x\n\n" % seed)
+        f.write("enum md_json_key {\n")
+
+        for k in keys:
+            f.write("    MD_JSON_KEY_%s,\n" % k.upper())
+
+        f.write("    MD_JSON_KEY_COUNT\n};\n\n")
+        f.write("//Returns the id of key, or -1 if key is unknown. key does "
+                "not have to be zero\n//terminated\n")
+        f.write("int16_t md_json_key_lookup(const char *key, size_t len);\n\n")
+        f.write("//Name of key with the given id\n")
+        f.write("const char* md_json_key_name(uint8_t id);\n")
+
+
+def write_source(path, keys, size, seed):
+    table = [0] * size
+
+    for i, k in enumerate(keys):
+        table[key_hash(k, seed, size - 1)] = i + 1
+
+    with open(path, 'w') as f:
+        f.write(HEADER)
+        f.write("\n#include <string.h>\n\n#include \"metadata_json_keys.h\"\n\n")
+        f.write("static const char *md_json_key_names[MD_JSON_KEY_COUNT] = {\n")
+
+        for k in keys:
+            f.write("    \"%s\",\n" % k)
+
+        f.write("};\n\n")
+        f.write("static const uint8_t md_json_key_lens[MD_JSON_KEY_COUNT] = {\n")
+
+        for i in range(0, len(keys), 12):
+            f.write("    %s,\n" % ", ".join(str(len(k)) for k in keys[i:i + 12]))
+
+        f.write("};\n\n")
+        f.write("//Hash slot to key id + 1, 0 is an empty slot\n")
+        f.write("static const uint8_t md_json_key_table[MD_JSON_KEY_TABLE_SIZE] = {\n")
+
+        for i in range(0, size, 16):
+            f.write("    %s,\n" % ", ".join(str(v) for v in table[i:i + 16]))
+
+        f.write("};\n\n")
+        f.write("""int16_t md_json_key_lookup(const char *key, size_t len)
+{
+    uint32_t h = MD_JSON_KEY_SEED;
+    uint8_t id;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        h = (h ^ (uint8_t) key[i]) * 16777619;
+
+    id = md_json_key_table[(h ^ (h >> 16)) & (MD_JSON_KEY_TABLE_SIZE - 1)];
+
+    if (!id-- || md_json_key_lens[id] != len ||
+        memcmp(md_json_key_names[id], key, len))
+        return -1;
+
+    return id;
+}
+
+const char* md_json_key_name(uint8_t id)
+{
+    return id < MD_JSON_KEY_COUNT ? md_json_key_names[id] : NULL;
+}
+""")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("Usage: %s <key list> <output directory>" % sys.argv[0])
+
+    keys = read_keys(sys.argv[1])
+
+    if len(keys) > 254:
+        sys.exit("Too many keys, ids must fit in a uint8_t")
+
+    size, seed = find_seed(keys)
+    write_header(os.path.join(sys.argv[2], "metadata_json_keys.h"), keys, size,
+                 seed)
+    write_source(os.path.join(sys.argv[2], "metadata_json_keys.c"), keys, size,
+                 seed)
+    print("%u keys, table size %u, seed 0x%08x" % (len(keys), size, seed))
+
+
+if __name__ == '__main__':
+    main()
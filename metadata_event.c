@@ -0,0 +1,344 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include JSON_LOC
+
+#include "metadata_exporter.h"
+#include "metadata_event.h"
+#include "metadata_slab.h"
+
+#define MD_EVENT_MAX_STR 8
+
+//Header placed in front of every cloned event. event must be last, the event
+//struct and the copied strings follow directly after the header
+struct md_event_ref {
+    uint32_t refcnt;
+    uint32_t size;
+    //Buffer the strings point into, NULL if the strings were copied
+    struct md_event_backing *backing;
+    //Node the event was received from, NULL for local events
+    const char *origin;
+    //Pool the clone was allocated from, NULL if it was malloc'ed
+    struct md_slab *pool;
+    uint64_t event[];
+};
+
+//Describes how to copy one event type. Offset 0 is the timestamp, so it is
+//safe to use as a terminator in str_offsets
+struct md_event_descr {
+    uint32_t md_type;
+    uint8_t event_param;
+    uint8_t has_json_blob;
+    uint16_t size;
+    uint16_t str_offsets[MD_EVENT_MAX_STR];
+};
+
+#define IFACE_STR_OFFSETS { \
+    offsetof(struct md_iface_event, iccid), \
+    offsetof(struct md_iface_event, imsi), \
+    offsetof(struct md_iface_event, imei), \
+    offsetof(struct md_iface_event, isp_name), \
+    offsetof(struct md_iface_event, ip_addr), \
+    offsetof(struct md_iface_event, internal_ip_addr), \
+    offsetof(struct md_iface_event, ifname), \
+    offsetof(struct md_iface_event, ca_info)}
+
+#define RADIO_STR_OFFSETS(type, ...) { \
+    offsetof(struct type, iccid), \
+    offsetof(struct type, imsi), \
+    offsetof(struct type, imei), \
+    ##__VA_ARGS__}
+
+//event_param 0 matches all parameters for a type
+static const struct md_event_descr md_event_descrs[] = {
+    {META_TYPE_INTERFACE, 0, 0, sizeof(struct md_iface_event),
+        IFACE_STR_OFFSETS},
+    {META_TYPE_SYSTEM, 0, 0, sizeof(md_system_event_t), IFACE_STR_OFFSETS},
+    {META_TYPE_CONNECTION, 0, 0, sizeof(struct md_conn_event), {
+        offsetof(struct md_conn_event, interface_id),
+        offsetof(struct md_conn_event, imei),
+        offsetof(struct md_conn_event, imsi),
+        offsetof(struct md_conn_event, interface_name),
+        offsetof(struct md_conn_event, network_address)}},
+    {META_TYPE_POS, 0, 0, sizeof(struct md_gps_event), {
+        offsetof(struct md_gps_event, nmea_raw)}},
+    {META_TYPE_MUNIN, 0, 1, sizeof(struct md_munin_event), {0}},
+    {META_TYPE_SYSEVENT, 0, 1, sizeof(struct md_sysevent), {0}},
+    {META_TYPE_RADIO, RADIO_EVENT_GSM_RR_CIPHER_MODE, 0,
+        sizeof(struct md_radio_gsm_rr_cipher_mode_event),
+        RADIO_STR_OFFSETS(md_radio_gsm_rr_cipher_mode_event)},
+    {META_TYPE_RADIO, RADIO_EVENT_GSM_RR_CHANNEL_CONF, 0,
+        sizeof(struct md_radio_gsm_rr_channel_conf_event),
+        RADIO_STR_OFFSETS(md_radio_gsm_rr_channel_conf_event,
+            offsetof(struct md_radio_gsm_rr_channel_conf_event,
+                after_channel_config),
+            offsetof(struct md_radio_gsm_rr_channel_conf_event,
+                before_channel_config))},
+    {META_TYPE_RADIO, RADIO_EVENT_CELL_LOCATION_GERAN, 0,
+        sizeof(struct md_radio_cell_loc_geran_event),
+        RADIO_STR_OFFSETS(md_radio_cell_loc_geran_event,
+            offsetof(struct md_radio_cell_loc_geran_event, plmn),
+            offsetof(struct md_radio_cell_loc_geran_event,
+                cell_geran_info_nmr))},
+    {META_TYPE_RADIO, RADIO_EVENT_GSM_RR_CELL_SEL_RESEL_PARAM, 0,
+        sizeof(struct md_radio_gsm_rr_cell_sel_reset_param_event),
+        RADIO_STR_OFFSETS(md_radio_gsm_rr_cell_sel_reset_param_event)},
+    {META_TYPE_RADIO, RADIO_EVENT_GRR_CELL_RESEL, 0,
+        sizeof(struct md_radio_grr_cell_resel_event),
+        RADIO_STR_OFFSETS(md_radio_grr_cell_resel_event,
+            offsetof(struct md_radio_grr_cell_resel_event, neighbors))},
+    {META_TYPE_RADIO, RADIO_EVENT_WCDMA_RRC_STATE, 0,
+        sizeof(struct md_radio_wcdma_rrc_state_event),
+        RADIO_STR_OFFSETS(md_radio_wcdma_rrc_state_event)},
+    {META_TYPE_RADIO, RADIO_EVENT_WCDMA_CELL_ID, 0,
+        sizeof(struct md_radio_wcdma_cell_id_event),
+        RADIO_STR_OFFSETS(md_radio_wcdma_cell_id_event)},
+};
+
+static const struct md_event_descr* md_event_get_descr(
+        const struct md_event *event)
+{
+    uint8_t event_param = 0;
+    size_t i;
+
+    if (event->md_type == META_TYPE_RADIO)
+        event_param = ((const struct md_radio_event*) event)->event_param;
+
+    for (i = 0; i < sizeof(md_event_descrs) / sizeof(md_event_descrs[0]);
+            i++) {
+        if (md_event_descrs[i].md_type == event->md_type &&
+            (!md_event_descrs[i].event_param ||
+             md_event_descrs[i].event_param == event_param))
+            return &md_event_descrs[i];
+    }
+
+    return NULL;
+}
+
+static inline struct md_event_ref* md_event_to_ref(struct md_event *event)
+{
+    return (struct md_event_ref*) (((uint8_t*) event) -
+            offsetof(struct md_event_ref, event));
+}
+
+static inline const char** md_event_str(struct md_event *event,
+        uint16_t offset)
+{
+    return (const char**) (((uint8_t*) event) + offset);
+}
+
+uint8_t md_event_is_shareable(const struct md_event *event)
+{
+    const struct md_event_descr *descr = md_event_get_descr(event);
+
+    return descr != NULL && !descr->has_json_blob;
+}
+
+uint8_t md_event_get_param(const struct md_event *event)
+{
+    switch (event->md_type) {
+    case META_TYPE_INTERFACE:
+    case META_TYPE_SYSTEM:
+        return ((const struct md_iface_event*) event)->event_param;
+    case META_TYPE_CONNECTION:
+        return ((const struct md_conn_event*) event)->event_param;
+    case META_TYPE_RADIO:
+        return ((const struct md_radio_event*) event)->event_param;
+    default:
+        return 0;
+    }
+}
+
+uint8_t md_event_is_conflatable(const struct md_event *event)
+{
+    const struct md_iface_event *iface;
+
+    if (event->md_type != META_TYPE_INTERFACE)
+        return 0;
+
+    iface = (const struct md_iface_event*) event;
+
+    return (iface->event_param == IFACE_EVENT_SIGNAL_CHANGE ||
+            iface->event_param == IFACE_EVENT_UPDATE) && iface->imei;
+}
+
+uint8_t md_event_conflates(const struct md_event *queued,
+                           const struct md_event *event)
+{
+    const struct md_iface_event *queued_iface, *iface;
+
+    if (!md_event_is_conflatable(event) || !md_event_is_conflatable(queued))
+        return 0;
+
+    queued_iface = (const struct md_iface_event*) queued;
+    iface = (const struct md_iface_event*) event;
+
+    return queued_iface->event_param == iface->event_param &&
+           !strcmp(queued_iface->imei, iface->imei);
+}
+
+void md_event_backing_get(struct md_event_backing *backing)
+{
+    __sync_add_and_fetch(&(backing->refcnt), 1);
+}
+
+void md_event_backing_put(struct md_event_backing *backing)
+{
+    if (!__sync_sub_and_fetch(&(backing->refcnt), 1))
+        backing->release(backing);
+}
+
+size_t md_event_clone_max_size()
+{
+    size_t size = 0;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(md_event_descrs) / sizeof(md_event_descrs[0]); i++) {
+        if (md_event_descrs[i].size > size)
+            size = md_event_descrs[i].size;
+    }
+
+    return offsetof(struct md_event_ref, event) + ((size + 7) & ~7);
+}
+
+static void md_event_ref_free(struct md_event_ref *ref)
+{
+    if (ref->pool)
+        md_slab_free_remote(ref->pool, ref);
+    else
+        free(ref);
+}
+
+struct md_event* md_event_clone(const struct md_event *event, uint32_t refcnt,
+                                struct md_event_backing *backing,
+                                const char *origin, struct md_slab *pool)
+{
+    const struct md_event_descr *descr = md_event_get_descr(event);
+    struct md_event_ref *ref;
+    struct md_event *clone;
+    const char *str;
+    uint8_t *str_buf;
+    size_t len, size;
+    uint8_t i;
+
+    if (descr == NULL)
+        return NULL;
+
+    //Round up so that strings never share the last word of the struct
+    size = offsetof(struct md_event_ref, event) + ((descr->size + 7) & ~7);
+
+    for (i = 0; backing == NULL && i < MD_EVENT_MAX_STR &&
+            descr->str_offsets[i]; i++) {
+        str = *md_event_str((struct md_event*) event, descr->str_offsets[i]);
+
+        if (str != NULL)
+            size += strlen(str) + 1;
+    }
+
+    //Clones with copied strings can be larger than the pool objects
+    if (pool != NULL && size <= pool->obj_size) {
+        if (!(ref = md_slab_alloc(pool)))
+            return NULL;
+    } else {
+        if (!(ref = malloc(size)))
+            return NULL;
+
+        pool = NULL;
+    }
+
+    ref->pool = pool;
+    ref->refcnt = refcnt;
+    ref->size = size;
+    ref->backing = backing;
+    ref->origin = origin;
+    clone = (struct md_event*) ref->event;
+    memcpy(clone, event, descr->size);
+
+    str_buf = ((uint8_t*) ref->event) + ((descr->size + 7) & ~7);
+
+    for (i = 0; backing == NULL && i < MD_EVENT_MAX_STR &&
+            descr->str_offsets[i]; i++) {
+        str = *md_event_str(clone, descr->str_offsets[i]);
+
+        if (str == NULL)
+            continue;
+
+        len = strlen(str) + 1;
+        memcpy(str_buf, str, len);
+        *md_event_str(clone, descr->str_offsets[i]) = (const char*) str_buf;
+        str_buf += len;
+    }
+
+    //json-c has no usable deep copy in all versions we build against, so the
+    //blob is copied by serializing and parsing it again
+    if (descr->has_json_blob && ((struct md_munin_event*) event)->json_blob) {
+        str = json_object_to_json_string_ext(
+                ((struct md_munin_event*) event)->json_blob,
+                JSON_C_TO_STRING_PLAIN);
+
+        if (!(((struct md_munin_event*) clone)->json_blob =
+                    json_tokener_parse(str))) {
+            md_event_ref_free(ref);
+            return NULL;
+        }
+    }
+
+    if (backing != NULL)
+        md_event_backing_get(backing);
+
+    return clone;
+}
+
+const char* md_event_get_origin(struct md_event *event)
+{
+    return md_event_to_ref(event)->origin;
+}
+
+void md_event_get(struct md_event *event)
+{
+    __sync_add_and_fetch(&(md_event_to_ref(event)->refcnt), 1);
+}
+
+void md_event_put(struct md_event *event)
+{
+    struct md_event_ref *ref = md_event_to_ref(event);
+
+    if (__sync_sub_and_fetch(&(ref->refcnt), 1))
+        return;
+
+    if ((event->md_type == META_TYPE_MUNIN ||
+         event->md_type == META_TYPE_SYSEVENT) &&
+        ((struct md_munin_event*) event)->json_blob)
+        json_object_put(((struct md_munin_event*) event)->json_blob);
+
+    if (ref->backing)
+        md_event_backing_put(ref->backing);
+
+    md_event_ref_free(ref);
+}
@@ -0,0 +1,98 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct md_event;
+struct md_slab;
+
+//Owner of a buffer that the strings of an event point into, e.g., a received
+//ZeroMQ message. When an event is cloned with a backing, the strings are not
+//copied. Instead the clone keeps a reference to the backing, which is released
+//together with the clone. release() is called when the last reference is
+//dropped, from whichever thread that happens to be
+struct md_event_backing {
+    uint32_t refcnt;
+    void (*release)(struct md_event_backing *backing);
+};
+
+//Inputs publish events that live on the stack or in buffers that are reused
+//for the next message, and the strings point into json-c objects that are
+//released as soon as publish returns. Before an event is handed to the writer
+//threads, it is copied into a single allocation (struct + strings) carrying a
+//reference counter. The last writer to release the event frees it.
+//
+//Events carrying a json_object (munin, sysevent) can not be shared, json-c
+//objects are not thread safe (even serializing modifies the object). These
+//must be cloned once per writer, see md_event_is_shareable().
+//
+//If backing is not NULL, the strings must point into the backing buffer and
+//are shared instead of copied.
+//
+//origin is the name of the node the event was received from (NULL for local
+//events). It is not copied and must outlive the event.
+//
+//If pool is not NULL and the clone fits, the clone is allocated from pool
+//instead of the heap. pool must be owned by the calling thread. The writers
+//return the clone with md_slab_free_remote()
+struct md_event* md_event_clone(const struct md_event *event, uint32_t refcnt,
+                                struct md_event_backing *backing,
+                                const char *origin, struct md_slab *pool);
+
+//Size of the largest clone with a backing, i.e., object size for a pool that
+//can hold every backed clone
+size_t md_event_clone_max_size();
+
+//Add/remove a reference. md_event_put() frees the event when the counter
+//reaches zero. Only valid for events returned by md_event_clone()
+void md_event_get(struct md_event *event);
+void md_event_put(struct md_event *event);
+
+uint8_t md_event_is_shareable(const struct md_event *event);
+
+//Origin of a cloned event, i.e., of an event passed to a writer. NULL if the
+//event was not received from a remote node
+const char* md_event_get_origin(struct md_event *event);
+
+//Add/remove a reference to a backing
+void md_event_backing_get(struct md_event_backing *backing);
+void md_event_backing_put(struct md_event_backing *backing);
+
+//Return event_param of event, or 0 if type has no event_param
+uint8_t md_event_get_param(const struct md_event *event);
+
+//Returns 1 if event is a snapshot-type event that can replace an older one,
+//i.e., md_event_conflates() can only return 1 for events where this is true
+uint8_t md_event_is_conflatable(const struct md_event *event);
+
+//Returns 1 if event is a newer version of queued, i.e., queued can be replaced
+//by event when a writer is backed up. Only snapshot-type events are conflated,
+//currently interface signal and update events (keyed on IMEI)
+uint8_t md_event_conflates(const struct md_event *queued,
+                           const struct md_event *event);
@@ -35,6 +35,9 @@
 #include <errno.h>
 #include <pthread.h>
 #include <syslog.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/signalfd.h>
 
 #include <libmnl/libmnl.h>
 #include JSON_LOC
@@ -76,6 +79,8 @@
 
 #include "backend_event_loop.h"
 #include "metadata_exporter_log.h"
+#include "metadata_event.h"
+#include "metadata_writer_queue.h"
 
 struct md_writer_file;
 struct md_input_gpsd;
@@ -84,39 +89,454 @@ struct md_input_sysevent;
 struct md_writer_sqlite;
 struct md_writer_zeromq;
 
+//Config keys of the inputs, indexed by enum md_inputs
+static const char *md_input_names[] = {
+    "netlink",
+    "gpsd",
+    "gps_nsb",
+    "munin",
+    "sysevent",
+    "zmq_input"
+};
+
+//Config keys of the writers, indexed by enum md_writers
+static const char *md_writer_names[] = {
+    "sqlite",
+    "zmq",
+    "nne",
+    "neat",
+    "file"
+};
+
 uint16_t mde_inc_seq(struct md_exporter *mde) {
-    uint16_t retval = mde->seq++;
+    uint16_t retval, seq;
+
+    //Called from both input and writer threads
+    do {
+        retval = mde->seq;
+        seq = retval + 1;
 
-    //We use 0 as false value when checking if variable is present
-    if (mde->seq == 0)
-        mde->seq = 1;
+        //We use 0 as false value when checking if variable is present
+        if (seq == 0)
+            seq = 1;
+    } while (!__sync_bool_compare_and_swap(&(mde->seq), retval, seq));
 
     return retval;
 }
 
+void mde_writer_subscribe(struct md_writer *writer, uint32_t md_type,
+                          uint32_t event_params)
+{
+    if (md_type > MD_TYPE_MAX)
+        return;
+
+    writer->subscriptions[md_type] |= event_params;
+}
+
+//Build the per-type list of writers, called once all writers are initialised
+static void mde_build_dispatch(struct md_exporter *mde)
+{
+    struct md_dispatch *dispatch;
+    uint32_t md_type;
+    uint8_t i;
+
+    for (md_type = 0; md_type <= MD_TYPE_MAX; md_type++) {
+        dispatch = &(mde->dispatch[md_type]);
+
+        for (i=0; i<=MD_WRITER_MAX; i++) {
+            if (mde->md_writers[i] != NULL &&
+                mde->md_writers[i]->handle != NULL &&
+                mde->md_writers[i]->subscriptions[md_type])
+                dispatch->writers[dispatch->num_writers++] = mde->md_writers[i];
+        }
+    }
+}
+
 void mde_publish_event_obj(struct md_exporter *mde, struct md_event *event)
 {
+    mde_publish_event_backed(mde, event, NULL, NULL, NULL);
+}
+
+void mde_publish_event_backed(struct md_exporter *mde, struct md_event *event,
+                              struct md_event_backing *backing,
+                              const char *origin, struct md_slab *pool)
+{
+    struct md_writer *writers[MD_WRITER_MAX + 1];
+    struct md_dispatch *dispatch;
+    struct md_event *clone = NULL;
+    uint32_t param_mask, subscription;
+    uint8_t i, num_writers = 0, shareable;
+
+    if (event->md_type > MD_TYPE_MAX)
+        return;
+
+    dispatch = &(mde->dispatch[event->md_type]);
+    param_mask = MD_EVENT_PARAM(md_event_get_param(event));
+
+    for (i=0; i<dispatch->num_writers; i++) {
+        subscription = dispatch->writers[i]->subscriptions[event->md_type];
+
+        if (param_mask ? (subscription & param_mask) :
+                         (subscription == MD_EVENT_PARAM_ALL))
+            writers[num_writers++] = dispatch->writers[i];
+    }
+
+    if (!num_writers)
+        return;
+
+    //Pass the object to every subscribed writer. Writers run in their own
+    //threads, so the event is copied and released by the last writer
+    shareable = md_event_is_shareable(event);
+
+    for (i=0; i<num_writers; i++) {
+        if (clone == NULL || !shareable)
+            clone = md_event_clone(event, shareable ? num_writers : 1,
+                    backing, origin, pool);
+
+        if (clone == NULL) {
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to copy event of type %u\n",
+                    event->md_type);
+            return;
+        }
+
+        md_writer_queue_push(writers[i]->queue, clone);
+    }
+}
+
+//Log number of wakeups since last time, and if epoll_wait has returned a full
+//batch, i.e., if max_events might be too small for the load on this loop
+static void mde_log_loop_stats(struct mde_loop *loop)
+{
+    struct backend_event_loop_stats *stats = &(loop->event_loop->stats);
+    uint64_t now = backend_time_ms();
+
+    if (now > loop->last_stats_ms)
+        META_PRINT_SYSLOG(loop->mde, LOG_INFO, "Event loop %s: %.2f wakeups/s\n",
+                loop->name, ((stats->wakeups - loop->last_wakeups) * 1000.0) /
+                (now - loop->last_stats_ms));
+
+    loop->last_wakeups = stats->wakeups;
+    loop->last_stats_ms = now;
+
+    if (stats->spins != loop->last_spins) {
+        META_PRINT_SYSLOG(loop->mde, LOG_INFO, "Event loop %s: busy poll hit %"
+                PRIu64 " of %" PRIu64 " spins (%.1f%%)\n", loop->name,
+                stats->spin_hits - loop->last_spin_hits,
+                stats->spins - loop->last_spins,
+                ((stats->spin_hits - loop->last_spin_hits) * 100.0) /
+                (stats->spins - loop->last_spins));
+        loop->last_spins = stats->spins;
+        loop->last_spin_hits = stats->spin_hits;
+    }
+
+    if (stats->full_batches == loop->last_full_batches)
+        return;
+
+    META_PRINT_SYSLOG(loop->mde, LOG_INFO, "Event loop %s: %" PRIu64 " waits, %"
+            PRIu64 " events, %" PRIu64 " (+%" PRIu64 ") full batches of %u\n",
+            loop->name, stats->waits, stats->events, stats->full_batches,
+            stats->full_batches - loop->last_full_batches,
+            loop->event_loop->max_events);
+
+    loop->last_full_batches = stats->full_batches;
+}
+
+//Posted to every loop by the stats timer, so that counters are only read by
+//the thread updating them
+static void mde_loop_stats_cb(void *ptr)
+{
+    struct mde_loop *loop = ptr;
     uint8_t i;
 
-    //Iterate through every handler and pass the object
-    for (i=0; i<=MD_WRITER_MAX; i++) {
-        if (mde->md_writers[i] != NULL &&
-            mde->md_writers[i]->handle != NULL)
-            mde->md_writers[i]->handle((struct md_writer*) mde->md_writers[i],
-                                       event);
+    mde_log_loop_stats(loop);
+
+    for (i=0; i<loop->num_inputs; i++) {
+        if (loop->inputs[i]->log_stats != NULL)
+            loop->inputs[i]->log_stats(loop->inputs[i]);
+    }
+
+    for (i=0; i<loop->num_writers; i++)
+        md_writer_queue_log_stats(loop->writers[i]->queue);
+}
+
+static void mde_stats_cb(void *ptr)
+{
+    struct md_exporter *mde = ptr;
+    uint8_t i;
+
+    for (i=0; i<mde->num_loops; i++) {
+        if (backend_event_loop_post(mde->loops[i].event_loop,
+                    mde_loop_stats_cb, &(mde->loops[i])))
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to post stats request to "
+                    "loop %s\n", mde->loops[i].name);
     }
 }
 
-static void mde_itr_cb(void *ptr)
+static void mde_loop_dump_line(void *ptr, const char *line)
+{
+    struct md_exporter *mde = ptr;
+
+    META_PRINT_SYSLOG(mde, LOG_INFO, "%s\n", line);
+}
+
+static void mde_loop_dump_cb(void *ptr)
+{
+    struct mde_loop *loop = ptr;
+
+    backend_event_loop_dump_stats(loop->event_loop, loop->name,
+            mde_loop_dump_line, loop->mde);
+}
+
+static void mde_handle_signal(void *ptr, int32_t fd, uint32_t events)
 {
     struct md_exporter *mde = ptr;
+    struct signalfd_siginfo si;
+    uint8_t i;
+
+    while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+        if (si.ssi_signo != SIGUSR1)
+            continue;
+
+        //Histograms are only touched by the thread running the loop
+        for (i=0; i<mde->num_loops; i++) {
+            if (backend_event_loop_post(mde->loops[i].event_loop,
+                        mde_loop_dump_cb, &(mde->loops[i])))
+                META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to post dump request "
+                        "to loop %s\n", mde->loops[i].name);
+        }
+    }
+}
+
+//Must be called before any threads are started, so that all threads inherit
+//the signal mask and SIGUSR1 is only read through the signalfd
+static uint8_t mde_setup_signals(struct md_exporter *mde)
+{
+    sigset_t mask;
+    int32_t sfd;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL)) {
+        META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to block SIGUSR1\n");
+        return RETVAL_FAILURE;
+    }
+
+    if ((sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+        META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to create signalfd: %s\n",
+                strerror(errno));
+        return RETVAL_FAILURE;
+    }
+
+    if (!(mde->signal_handle = backend_create_epoll_handle(mde, sfd,
+                    mde_handle_signal)))
+        return RETVAL_FAILURE;
+
+    mde->signal_handle->name = "signal";
+
+    return backend_event_loop_update(mde->event_loop, EPOLLIN, EPOLL_CTL_ADD,
+            sfd, mde->signal_handle);
+}
+
+//Return the loop called name, create it if it does not exist
+static struct mde_loop* mde_get_loop(struct md_exporter *mde, const char *name)
+{
+    struct mde_loop *loop;
+    uint8_t i;
+
+    for (i=0; i<mde->num_loops; i++) {
+        if (!strcmp(mde->loops[i].name, name))
+            return &(mde->loops[i]);
+    }
+
+    if (mde->num_loops == MDE_MAX_LOOPS)
+        return NULL;
+
+    loop = &(mde->loops[mde->num_loops]);
+
+    if (!(loop->name = strdup(name)))
+        return NULL;
+
+    if (!(loop->event_loop = backend_event_loop_create()) ||
+        backend_event_loop_configure(loop->event_loop, mde->loop_max_events,
+            mde->loop_edge_triggered)) {
+        free(loop->name);
+        return NULL;
+    }
+
+    loop->mde = mde;
+    loop->last_stats_ms = backend_time_ms();
+    mde->num_loops++;
+
+    return loop;
+}
+
+//Read the "loop" key from the object config[key], default_name if not present
+static const char* mde_get_loop_name(json_object *config, const char *key,
+                                     const char *default_name)
+{
+    json_object *subconfig, *loop_name;
+
+    if (json_object_object_get_ex(config, key, &subconfig) &&
+        json_object_object_get_ex(subconfig, "loop", &loop_name))
+        return json_object_get_string(loop_name);
+
+    return default_name;
+}
+
+//Assign every input and writer to a loop. Inputs use the main loop by
+//default, while every writer gets a loop (and thread) of its own
+static uint8_t mde_attach_loops(struct md_exporter *mde, json_object *config)
+{
+    struct mde_loop *loop;
+    const char *name;
     uint8_t i;
 
+    for (i=0; i<=MD_INPUT_MAX; i++) {
+        if (mde->md_inputs[i] == NULL)
+            continue;
+
+        name = mde_get_loop_name(config, md_input_names[i], MDE_MAIN_LOOP);
+
+        if (!(loop = mde_get_loop(mde, name))) {
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Could not create loop %s\n", name);
+            return RETVAL_FAILURE;
+        }
+
+        mde->md_inputs[i]->event_loop = loop->event_loop;
+        loop->inputs[loop->num_inputs++] = mde->md_inputs[i];
+    }
+
     for (i=0; i<=MD_WRITER_MAX; i++) {
-        if (mde->md_writers[i] != NULL &&
-            mde->md_writers[i]->itr_cb != NULL)
-            mde->md_writers[i]->itr_cb(mde->md_writers[i]);
+        if (mde->md_writers[i] == NULL)
+            continue;
+
+        name = mde_get_loop_name(config, md_writer_names[i],
+                md_writer_names[i]);
+
+        if (!(loop = mde_get_loop(mde, name))) {
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Could not create loop %s\n", name);
+            return RETVAL_FAILURE;
+        }
+
+        mde->md_writers[i]->event_loop = loop->event_loop;
+        loop->writers[loop->num_writers++] = mde->md_writers[i];
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+struct backend_event_loop* mde_attach_input_loop(struct md_exporter *mde,
+                                                 const char *name,
+                                                 struct md_input *sub)
+{
+    struct mde_loop *loop;
+
+    if (!(loop = mde_get_loop(mde, name)) ||
+        loop->num_inputs == MD_INPUT_MAX + 1) {
+        META_PRINT_SYSLOG(mde, LOG_ERR, "Could not create loop %s\n", name);
+        return NULL;
+    }
+
+    loop->inputs[loop->num_inputs++] = sub;
+    return loop->event_loop;
+}
+
+//A writer sharing a loop with an input must not block, the thread waiting for
+//room in the queue is the one that has to empty it
+static uint8_t mde_check_loops(struct md_exporter *mde)
+{
+    struct mde_loop *loop;
+    uint8_t i, j;
+
+    for (i=0; i<mde->num_loops; i++) {
+        loop = &(mde->loops[i]);
+
+        if (!loop->num_inputs)
+            continue;
+
+        for (j=0; j<loop->num_writers; j++) {
+            if (loop->writers[j]->queue->policy != MD_WRITER_QUEUE_BLOCK)
+                continue;
+
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Writer %s shares loop %s with an "
+                    "input, queue_policy block is not allowed\n",
+                    loop->writers[j]->queue->name, loop->name);
+            return RETVAL_FAILURE;
+        }
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+static void *mde_loop_thread(void *ptr)
+{
+    struct mde_loop *loop = ptr;
+
+    backend_event_loop_run(loop->event_loop);
+
+    META_PRINT_SYSLOG(loop->mde, LOG_ERR, "Loop thread %s should NEVER exit\n",
+            loop->name);
+    exit(EXIT_FAILURE);
+
+    return NULL;
+}
+
+//Start a thread for every loop, except main
+static uint8_t mde_start_loops(struct md_exporter *mde)
+{
+    struct mde_loop *loop;
+    char thread_name[16];
+    uint8_t i;
+    int retval;
+
+    for (i=1; i<mde->num_loops; i++) {
+        loop = &(mde->loops[i]);
+
+        if ((retval = pthread_create(&(loop->thread), NULL, mde_loop_thread,
+                        loop))) {
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to start thread for loop "
+                    "%s: %s\n", loop->name, strerror(retval));
+            return RETVAL_FAILURE;
+        }
+
+        //Makes it easier to see which loop is busy in top/perf
+        snprintf(thread_name, sizeof(thread_name), "mde-%s", loop->name);
+        pthread_setname_np(loop->thread, thread_name);
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+static uint8_t mde_configure_event_loop(struct md_exporter *mde,
+                                        json_object *config)
+{
+    int32_t max_events;
+
+    json_object_object_foreach(config, key, val) {
+        if (!strcmp(key, "max_events")) {
+            max_events = json_object_get_int(val);
+
+            if (max_events <= 0) {
+                META_PRINT_SYSLOG(mde, LOG_ERR, "Invalid max_events\n");
+                return RETVAL_FAILURE;
+            }
+
+            mde->loop_max_events = max_events;
+        } else if (!strcmp(key, "edge_triggered")) {
+            mde->loop_edge_triggered = json_object_get_int(val);
+        }
+    }
+
+    //Only main exists at this point, the other loops are created after the
+    //config has been parsed
+    if (backend_event_loop_configure(mde->event_loop, mde->loop_max_events,
+                mde->loop_edge_triggered)) {
+        META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to configure event loop\n");
+        return RETVAL_FAILURE;
     }
+
+    return RETVAL_SUCCESS;
 }
 
 //TODO: Refactor, create a backend helpers file?
@@ -124,13 +544,7 @@ void mde_start_timer(struct backend_event_loop *event_loop,
                      struct backend_timeout_handle *timeout_handle,
                      uint32_t timeout)
 {
-    struct timeval tv;
-    uint64_t cur_time;
-
-    gettimeofday(&tv, NULL);
-    cur_time = (tv.tv_sec * 1e3) + (tv.tv_usec / 1e3);
-
-    timeout_handle->timeout_clock = cur_time + timeout;
+    timeout_handle->timeout_clock = backend_time_ms() + timeout;
     backend_insert_timeout(event_loop, timeout_handle);
 }
 
@@ -154,13 +568,14 @@ static int configure_core(struct md_exporter **mde)
         return RETVAL_FAILURE;
     }
 
-    if(!((*mde)->event_loop = backend_event_loop_create()))
-        return RETVAL_FAILURE;
-
     (*mde)->seq = 1;
-    (*mde)->event_loop->itr_cb = mde_itr_cb;
-    (*mde)->event_loop->itr_data = *mde;
     (*mde)->logfile = stderr;
+    (*mde)->loop_max_events = MAX_EPOLL_EVENTS;
+
+    if (!mde_get_loop(*mde, MDE_MAIN_LOOP))
+        return RETVAL_FAILURE;
+
+    (*mde)->event_loop = (*mde)->loops[0].event_loop;
 
     return RETVAL_SUCCESS;
 }
@@ -170,7 +585,13 @@ static void default_usage()
     fprintf(stderr, "Parameters. At least one input and one writer must be specified in the configuration.\n");
     fprintf(stderr, "Default:\n");
     fprintf(stderr, "-c: JSON configuration file for the metadata exporter\n");
-    fprintf(stderr, "-h: Display usage of exporter, inputs and writers\n\n");
+    fprintf(stderr, "-h: Display usage of exporter, inputs and writers\n");
+    fprintf(stderr, "Send SIGUSR1 to write callback latency histograms and timer lateness for all loops to the log\n\n");
+    fprintf(stderr, "\"event_loop\": {\t\tOptional, applies to all event loops\n");
+    fprintf(stderr, "  \"max_events\":\t\tmax events returned by one epoll_wait (default: %u)\n",
+            MAX_EPOLL_EVENTS);
+    fprintf(stderr, "  \"edge_triggered\":\tregister sockets that are always drained with EPOLLET (default: 0)\n");
+    fprintf(stderr, "},\n");
 }
 
 static void print_usage()
@@ -190,6 +611,9 @@ static void print_usage()
 #ifdef SYSEVENT_SUPPORT
     md_sysevent_usage();
 #endif
+    fprintf(stderr, "Every input also accepts:\n");
+    fprintf(stderr, "  \"loop\":\t\tname of event loop/thread to run on (default: %s)\n",
+            MDE_MAIN_LOOP);
     fprintf(stderr, "WRITERS:\n");
 #ifdef NEAT_SUPPORT
     md_neat_usage();
@@ -203,6 +627,7 @@ static void print_usage()
 #ifdef ZEROMQ_SUPPORT_WRITER
     md_zeromq_writer_usage();
 #endif
+    md_writer_queue_usage();
 }
 
 void read_config(char* config_file, json_object** config_obj)
@@ -255,6 +680,10 @@ int main(int argc, char *argv[])
     if (configure_core(&mde))
         exit(EXIT_FAILURE);
 
+    //Inputs and writers might start threads (e.g., ZeroMQ) during init
+    if (mde_setup_signals(mde))
+        exit(EXIT_FAILURE);
+
     //Process core options, short options allowed. We do this here since we need
     //an allocated writers array
     opterr = 0;
@@ -279,6 +708,9 @@ int main(int argc, char *argv[])
             logfile_path = json_object_get_string(val); 
         } else if (!strcmp(key, "syslog")) {
             mde->use_syslog = json_object_get_int(val);
+        } else if (!strcmp(key, "event_loop")) {
+            if (mde_configure_event_loop(mde, val))
+                exit(EXIT_FAILURE);
         }
 #ifdef GPS_NSB_SUPPORT
         else if (!strcmp(key, "gps_nsb")) {
@@ -426,6 +858,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (mde_attach_loops(mde, config))
+        exit(EXIT_FAILURE);
+
     for (i=0; i<=MD_INPUT_MAX; i++) {
         if (mde->md_inputs[i] != NULL) {
             META_PRINT_SYSLOG(mde, LOG_INFO, "Will configure input %d\n", i);
@@ -437,6 +872,23 @@ int main(int argc, char *argv[])
         }
     }
 
+    //Queues are created before the writers are initialised, so that an invalid
+    //queue config is caught before writers open files and sockets
+    for (i=0; i<=MD_WRITER_MAX; i++) {
+        if (mde->md_writers[i] == NULL)
+            continue;
+
+        if (!(mde->md_writers[i]->queue = md_writer_queue_create(
+                        mde->md_writers[i], md_writer_names[i], config))) {
+            META_PRINT_SYSLOG(mde, LOG_ERR, "Could not create queue for "
+                    "writer %s\n", md_writer_names[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (mde_check_loops(mde))
+        exit(EXIT_FAILURE);
+
     for (i=0; i<=MD_WRITER_MAX; i++) {
         if (mde->md_writers[i] != NULL) {
             META_PRINT_SYSLOG(mde, LOG_INFO, "Will configure writer %d\n", i);
@@ -450,6 +902,21 @@ int main(int argc, char *argv[])
 
     json_object_put(config);
 
+    mde_build_dispatch(mde);
+
+    if (mde_start_loops(mde))
+        exit(EXIT_FAILURE);
+
+    if (!(mde->stats_handle = backend_event_loop_create_timeout(0,
+                    mde_stats_cb, mde, MDE_STATS_INTVL))) {
+        META_PRINT_SYSLOG(mde, LOG_ERR, "Failed to create stats timer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    mde->stats_handle->name = "stats";
+    mde->stats_handle->slack = MDE_STATS_SLACK;
+    mde_start_timer(mde->event_loop, mde->stats_handle, MDE_STATS_INTVL);
+
     backend_event_loop_run(mde->event_loop);
 
     META_PRINT_SYSLOG(mde, LOG_ERR, "Threads should NEVER exit\n");
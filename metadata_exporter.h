@@ -40,11 +40,22 @@
 #define OUTPUT_FORMAT_BUF_SIZE 20
 
 #define MDE_VERSION 1
+//How often (ms) the core checks for and logs writer queue drops
+#define MDE_STATS_INTVL 60000
+//Timer slack (ms) for the stats timer, see backend_timeout_handle
+#define MDE_STATS_SLACK 5000
 #define METADATA_NL_GROUP 0x03
 
 #define MD_INPUT_MAX (__MD_INPUT_MAX - 1)
 #define MD_WRITER_MAX (__MD_WRITER_MAX - 1)
 
+//Name of the loop running on the main thread, used by inputs by default
+#define MDE_MAIN_LOOP "main"
+//Max number of extra loops created by inputs, see mde_attach_input_loop()
+#define MDE_MAX_INPUT_LOOPS 15
+//Every input and writer can in theory get its own loop, plus main
+#define MDE_MAX_LOOPS (MD_INPUT_MAX + MD_WRITER_MAX + MDE_MAX_INPUT_LOOPS + 3)
+
 #define META_TYPE_INTERFACE  0x01
 #define META_TYPE_CONNECTION 0x02
 #define META_TYPE_POS        0x04
@@ -52,6 +63,17 @@
 #define META_TYPE_SYSEVENT   0x06
 #define META_TYPE_RADIO      0x08
 #define META_TYPE_SYSTEM     0x10
+//Largest type, used for sizing the dispatch table
+#define MD_TYPE_MAX          META_TYPE_SYSTEM
+
+//Writers subscribe to a set of event_params per type. Types without
+//event_param (for example POS) use param 0, so subscribe with
+//MD_EVENT_PARAM_ALL. event_param comes from the wire, params that do not fit
+//in the mask give 0 and are only passed to MD_EVENT_PARAM_ALL subscribers
+#define MD_EVENT_PARAM_BITS   32
+#define MD_EVENT_PARAM(param) \
+    ((uint32_t) (param) < MD_EVENT_PARAM_BITS ? 1U << (param) : 0U)
+#define MD_EVENT_PARAM_ALL    0xFFFFFFFF
 
 #define DEFAULT_RSSI       -127
 #define DEFAULT_RSRQ          0
@@ -139,16 +161,30 @@ enum md_writers {
     __MD_WRITER_MAX
 };
 
+//event_loop is set by the core before init is called, all fds and timers must
+//be added to this loop. log_stats is optional, it is called every
+//MDE_STATS_INTVL ms from the input's loop
 #define MD_INPUT \
     struct md_exporter *parent; \
+    struct backend_event_loop *event_loop; \
     uint8_t (*init)(void *ptr, json_object* config); \
     void (*destroy)(void *ptr); \
+    void (*log_stats)(void *ptr); \
 
+//event_loop and queue are set by the core before init is called. Each writer
+//runs on its own thread, all timers must be added to the writer's event_loop.
+//handle_batch is optional. If set, it is called instead of handle with all
+//events that were queued since the writer last woke up (max
+//MD_WRITER_QUEUE_BURST at a time)
 #define MD_WRITER \
     struct md_exporter *parent; \
+    struct backend_event_loop *event_loop; \
+    struct md_writer_queue *queue; \
+    uint32_t subscriptions[MD_TYPE_MAX + 1]; \
     int32_t (*init)(void *ptr, json_object* config); \
     void (*handle)(struct md_writer *writer, struct md_event *event); \
-    void (*itr_cb)(void *ptr); \
+    void (*handle_batch)(struct md_writer *writer, struct md_event **events, \
+                         uint32_t num_events); \
     void (*usage)()
 
 #define MD_EVENT \
@@ -169,7 +205,10 @@ struct backend_epoll_handle;
 struct backend_timeout_handle;
 struct md_input;
 struct md_writer;
+struct md_writer_queue;
 struct md_event;
+struct md_event_backing;
+struct md_slab;
 
 //TODO: Maybe moved this to some shared header file?
 struct md_iface_event {
@@ -335,16 +374,52 @@ struct md_radio_wcdma_cell_id_event {
 
 #define md_sysevent md_munin_event
 
+//One event loop and the thread running it. Inputs and writers select their
+//loop with the "loop" key in their config object. Loop 0 is MDE_MAIN_LOOP and
+//runs on the main thread
+struct mde_loop {
+    struct md_exporter *mde;
+    struct backend_event_loop *event_loop;
+    char *name;
+    pthread_t thread;
+    struct md_input *inputs[MD_INPUT_MAX + 1];
+    struct md_writer *writers[MD_WRITER_MAX + 1];
+    uint8_t num_inputs;
+    uint8_t num_writers;
+    uint64_t last_full_batches;
+    uint64_t last_wakeups;
+    uint64_t last_stats_ms;
+    uint64_t last_spins;
+    uint64_t last_spin_hits;
+};
+
+//Writers that have subscribed to (some of the params of) one type
+struct md_dispatch {
+    struct md_writer *writers[MD_WRITER_MAX + 1];
+    uint8_t num_writers;
+};
+
 struct md_exporter {
     struct mnl_socket *metadata_sock;
     struct backend_event_loop *event_loop;
     struct backend_epoll_handle *event_handle;
+    struct backend_timeout_handle *stats_handle;
+    //SIGUSR1 is read from a signalfd and triggers a dump of loop stats
+    struct backend_epoll_handle *signal_handle;
     FILE *logfile;
 
     struct md_input *md_inputs[MD_INPUT_MAX + 1];
     struct md_writer *md_writers[MD_WRITER_MAX + 1];
+    struct md_dispatch dispatch[MD_TYPE_MAX + 1];
     struct md_conn_event *mce;
 
+    struct mde_loop loops[MDE_MAX_LOOPS];
+    uint8_t num_loops;
+
+    //Applied to all event loops, set from the event_loop config object
+    uint32_t loop_max_events;
+    uint8_t loop_edge_triggered;
+
     //Keep track of order in which events arrived at metadata exporter. There
     //could also be a per-app sequence number
     uint16_t seq;
@@ -369,5 +444,26 @@ void mde_start_timer(struct backend_event_loop *event_loop,
 
 void mde_publish_event_obj(struct md_exporter *mde, struct md_event *event);
 
+//Same as mde_publish_event_obj(), but the strings of event point into backing.
+//The writers share the backing instead of getting a copy of the strings.
+//origin is the name of the node the event came from, NULL for local events.
+//The copies are allocated from pool (if not NULL), see md_event_clone()
+void mde_publish_event_backed(struct md_exporter *mde, struct md_event *event,
+                              struct md_event_backing *backing,
+                              const char *origin, struct md_slab *pool);
+
+//Used by inputs that spread their work over several threads. sub is run on the
+//loop called name (created if it does not exist), and registered like an input
+//so that its log_stats is called from the loop's thread. Only valid during init
+struct backend_event_loop* mde_attach_input_loop(struct md_exporter *mde,
+                                                 const char *name,
+                                                 struct md_input *sub);
+
+//Called by the writers during init, to tell the core which event types and
+//event_params (MD_EVENT_PARAM()-mask) they want. Events that no writer has
+//subscribed to are never copied or queued
+void mde_writer_subscribe(struct md_writer *writer, uint32_t md_type,
+                          uint32_t event_params);
+
 uint16_t mde_inc_seq(struct md_exporter *mde);
 #endif
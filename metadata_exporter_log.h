@@ -39,9 +39,9 @@
 #define META_PRINT(fd, _fmt, ...) \
     do { \
     time_t rawtime; \
-    struct tm *curtime; \
+    struct tm tm_buf, *curtime; \
     time(&rawtime); \
-    curtime = gmtime(&rawtime); \
+    curtime = gmtime_r(&rawtime, &tm_buf); \
     META_PRINT2(fd, META_LOG_PREFIX _fmt, curtime->tm_hour, \
         curtime->tm_min, curtime->tm_sec, curtime->tm_mday, \
         curtime->tm_mon + 1, 1900 + curtime->tm_year, \
@@ -50,9 +50,9 @@
 #define META_PRINT_SYSLOG(mde, priority, _fmt, ...) \
     do { \
     time_t rawtime; \
-    struct tm *curtime; \
+    struct tm tm_buf, *curtime; \
     time(&rawtime); \
-    curtime = gmtime(&rawtime); \
+    curtime = gmtime_r(&rawtime, &tm_buf); \
     if (mde->use_syslog) \
         META_SYSLOG(priority, _fmt, ##__VA_ARGS__); \
     META_PRINT2(mde->logfile, META_LOG_PREFIX _fmt, \
@@ -0,0 +1,91 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "metadata_input_budget.h"
+
+void md_input_budget_init(struct md_input_budget *budget, backend_task_cb cb,
+        void *ptr, const char *name)
+{
+    memset(budget, 0, sizeof(struct md_input_budget));
+    budget->max_msgs = MD_INPUT_BUDGET_DEFAULT_MSGS;
+    backend_task_init(&(budget->task), cb, ptr, name);
+}
+
+uint8_t md_input_budget_config(struct md_input_budget *budget, const char *key,
+        json_object *val)
+{
+    if (!strcmp(key, "budget_msgs"))
+        budget->max_msgs = (uint32_t) json_object_get_int(val);
+    else if (!strcmp(key, "budget_us"))
+        budget->max_us = (uint32_t) json_object_get_int(val);
+    else
+        return 0;
+
+    return 1;
+}
+
+void md_input_budget_start(struct md_input_budget *budget)
+{
+    //The fd might be reported while the handler is waiting to be resumed, the
+    //task is then not needed
+    backend_cancel_task(&(budget->task));
+    budget->msgs = 0;
+
+    if (budget->max_us)
+        budget->deadline_us = backend_time_us() + budget->max_us;
+}
+
+uint8_t md_input_budget_spent(struct md_input_budget *budget)
+{
+    if (budget->max_msgs && budget->msgs == budget->max_msgs)
+        return 1;
+
+    //Always allow one message, so that the handler makes progress
+    if (budget->max_us && budget->msgs &&
+        backend_time_us() >= budget->deadline_us)
+        return 1;
+
+    budget->msgs++;
+    return 0;
+}
+
+void md_input_budget_yield(struct md_input_budget *budget,
+        struct backend_event_loop *event_loop)
+{
+    budget->yields++;
+    backend_schedule_task(event_loop, &(budget->task), BACKEND_TASK_NEXT);
+}
+
+void md_input_budget_usage()
+{
+    fprintf(stderr, "  \"budget_msgs\":\tmax messages handled per wakeup, 0 is no limit (default: %u)\n",
+            MD_INPUT_BUDGET_DEFAULT_MSGS);
+    fprintf(stderr, "  \"budget_us\":\t\tmax time (us) spent per wakeup, 0 is no limit (default: 0)\n");
+}
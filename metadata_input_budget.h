@@ -0,0 +1,76 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+
+#include JSON_LOC
+
+#include "backend_event_loop.h"
+
+//Default max number of messages an input handles per wakeup
+#define MD_INPUT_BUDGET_DEFAULT_MSGS    64
+
+//Limits how much work an input does in one callback, so that a source that
+//is bursting does not starve timers and other inputs on the same loop. When
+//the budget is spent, the handler stops reading and schedules a task that
+//calls it again on the next iteration of the loop. The task is needed since
+//the inputs are edge triggered (ZMQ_FD), the fd will not be reported again
+//for the messages that are left
+struct md_input_budget {
+    //0 means no limit
+    uint32_t max_msgs;
+    uint32_t max_us;
+
+    uint32_t msgs;
+    uint64_t deadline_us;
+    //Number of times the handler had to yield with messages left
+    uint64_t yields;
+    uint64_t last_yields;
+    struct backend_task task;
+};
+
+//cb(ptr) is called when the handler is resumed
+void md_input_budget_init(struct md_input_budget *budget, backend_task_cb cb,
+        void *ptr, const char *name);
+
+//Parse budget_msgs/budget_us, returns 1 if key was a budget key
+uint8_t md_input_budget_config(struct md_input_budget *budget, const char *key,
+        json_object *val);
+
+//Called when the handler starts reading
+void md_input_budget_start(struct md_input_budget *budget);
+
+//Called before every message. Returns 1 if the budget is spent, the handler
+//must then call md_input_budget_yield() and return
+uint8_t md_input_budget_spent(struct md_input_budget *budget);
+
+void md_input_budget_yield(struct md_input_budget *budget,
+        struct backend_event_loop *event_loop);
+
+void md_input_budget_usage();
@@ -59,7 +59,7 @@ static void md_input_gps_nsb_handle_event(void *ptr, int32_t fd, uint32_t events
             META_PRINT_SYSLOG(mign->parent, LOG_ERR, "NSB GPS error\n");
             close(mign->sockfd);
             mign->sockfd = 0;
-            mde_start_timer(mign->parent->event_loop, mign->sock_timeout_handle,
+            mde_start_timer(mign->event_loop, mign->sock_timeout_handle,
                     MD_GPS_NSB_SOCK_INTVL);
         }
 
@@ -137,9 +137,11 @@ static uint8_t md_input_gps_nsb_create_socket(struct md_input_gps_nsb *mign)
         if(!(mign->event_handle = backend_create_epoll_handle(mign,
                         sockfd, md_input_gps_nsb_handle_event)))
             return RETVAL_FAILURE;
+
+        mign->event_handle->name = "gps_nsb";
     }
    
-    backend_event_loop_update(mign->parent->event_loop, EPOLLIN, EPOLL_CTL_ADD,
+    backend_event_loop_update(mign->event_loop, EPOLLIN, EPOLL_CTL_ADD,
         sockfd, mign->event_handle);
 
     mign->sockfd = sockfd;
@@ -151,11 +153,9 @@ static void md_input_gps_nsb_sock_timeout(void *ptr)
 {
     struct md_input_gps_nsb *mign = ptr;
 
-    if (md_input_gps_nsb_create_socket(mign) == RETVAL_FAILURE) {
-        mign->sock_timeout_handle->intvl = MD_GPS_NSB_SOCK_INTVL;
-    } else {
-        mign->sock_timeout_handle->intvl = 0;
-    }
+    if (md_input_gps_nsb_create_socket(mign) == RETVAL_FAILURE)
+        mde_start_timer(mign->event_loop, mign->sock_timeout_handle,
+                MD_GPS_NSB_SOCK_INTVL);
 }
 
 static uint8_t md_input_gps_nsb_config(struct md_input_gps_nsb *mign,
@@ -164,7 +164,7 @@ static uint8_t md_input_gps_nsb_config(struct md_input_gps_nsb *mign,
 {
     //call create_socket
     if (md_input_gps_nsb_create_socket(mign) == RETVAL_FAILURE) {
-        mde_start_timer(mign->parent->event_loop, mign->sock_timeout_handle,
+        mde_start_timer(mign->event_loop, mign->sock_timeout_handle,
                 MD_GPS_NSB_SOCK_INTVL);
     }
 
@@ -207,6 +207,9 @@ static uint8_t md_input_gps_nsb_init(void *ptr, json_object* config)
         return RETVAL_FAILURE;
     }
 
+    mign->sock_timeout_handle->name = "gps_nsb socket";
+    mign->sock_timeout_handle->slack = MD_GPS_NSB_SOCK_SLACK;
+
     return md_input_gps_nsb_config(mign, address, port);
 }
 
@@ -30,6 +30,7 @@
 #include "metadata_exporter.h"
 
 #define MD_GPS_NSB_SOCK_INTVL   1000
+#define MD_GPS_NSB_SOCK_SLACK   500
 
 struct backend_epoll_handle;
 
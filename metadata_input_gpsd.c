@@ -52,11 +52,7 @@ static void md_input_gpsd_handle_connect_timeout(void *ptr)
     META_PRINT_SYSLOG(mig->parent, LOG_INFO, "GPSD reconnect succesful\n");
 
     //Stop timer if connect is successful
-    //TODO: Currently, the event loop removes timers and the adds the timer back
-    //to the list again if interval is set. This is not really ideal behavior,
-    //it makes it a bit tricky to properly clean-up timeouts. However, no time
-    //to look into that now, so just set intvl to 0 to get desired behavior
-    mig->connect_timeout_handle->intvl = 0;
+    backend_remove_timeout(mig->connect_timeout_handle);
 }
 
 static void md_input_gpsd_handle_event(void *ptr, int32_t fd, uint32_t events)
@@ -69,11 +65,11 @@ static void md_input_gpsd_handle_event(void *ptr, int32_t fd, uint32_t events)
         gps_close(&(mig->gps_data));
 
         //Use a timer to try to reconnect to gpsd, since it might take some time
-        //before it is restarted. No need to use the helper function and set a
-        //timestamp, we want the timeout be triggered on next iteration of loop
-        mig->connect_timeout_handle->intvl = 5000;
-        backend_insert_timeout(mig->parent->event_loop,
-                mig->connect_timeout_handle);
+        //before it is restarted. Timeout is triggered on next iteration of
+        //loop, and then every 5 seconds until connect succeeds
+        mig->connect_timeout_handle->intvl = MD_GPSD_RECONNECT_INTVL;
+        mde_start_timer(mig->event_loop, mig->connect_timeout_handle,
+                0);
         return;
     }
 
@@ -114,7 +110,7 @@ static uint8_t md_input_gpsd_connect(struct md_input_gpsd *mig)
         return RETVAL_FAILURE;
     }
 
-    backend_event_loop_update(mig->parent->event_loop, EPOLLIN, EPOLL_CTL_ADD,
+    backend_event_loop_update(mig->event_loop, EPOLLIN, EPOLL_CTL_ADD,
         mig->gps_data.gps_fd, mig->event_handle);
 
     return RETVAL_SUCCESS;
@@ -131,6 +127,10 @@ static uint8_t md_gpsd_config(struct md_input_gpsd *mig,
     if(!(mig->connect_timeout_handle = backend_event_loop_create_timeout(0,
                     md_input_gpsd_handle_connect_timeout, mig, 0)))
         return RETVAL_FAILURE;
+
+    mig->event_handle->name = "gpsd";
+    mig->connect_timeout_handle->name = "gpsd reconnect";
+    mig->connect_timeout_handle->slack = MD_GPSD_RECONNECT_SLACK;
     
     //Cache address/port in cache gpsd fails while running
     mig->gpsd_addr = strdup(address);
@@ -31,6 +31,9 @@
 
 #include "metadata_exporter.h"
 
+#define MD_GPSD_RECONNECT_INTVL 5000
+#define MD_GPSD_RECONNECT_SLACK 1000
+
 struct backend_epoll_handle;
 
 struct md_input_gpsd {
@@ -274,8 +274,9 @@ static uint8_t md_munin_config(struct md_input_munin *mim,
                                mim, timer, md_input_munin_handle_event)))
         return RETVAL_FAILURE;
 
+      mim->event_handle->name = "munin";
       backend_event_loop_update(
-          mim->parent->event_loop, EPOLLIN, EPOLL_CTL_ADD, timer, mim->event_handle);
+          mim->event_loop, EPOLLIN, EPOLL_CTL_ADD, timer, mim->event_handle);
 
       return RETVAL_SUCCESS;
     } else {
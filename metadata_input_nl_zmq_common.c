@@ -4,58 +4,197 @@
 #include "metadata_exporter_log.h"
 #include "metadata_input_nl_zmq_common.h"
 
-uint8_t parse_conn_info(struct json_object *meta_obj, struct md_conn_event *mce, struct md_exporter *parent)
+#define CONN_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_conn_event, member)
+
+static const struct md_json_field conn_fields[] = {
+    CONN_FIELD(MD_SEQ, INT16, sequence),
+    CONN_FIELD(TIMESTAMP, INT64, tstamp),
+    CONN_FIELD(EVENT_TYPE, INT8, event_type),
+    CONN_FIELD(EVENT_PARAM, INT8, event_param),
+    CONN_FIELD(EVENT_VALUE, INT8, event_value),
+    CONN_FIELD(INTERFACE_ID_TYPE, INT8, interface_id_type),
+    CONN_FIELD(INTERFACE_ID, STR, interface_id),
+    CONN_FIELD(IMEI, STR, imei),
+    CONN_FIELD(IMSI, STR, imsi),
+    CONN_FIELD(INTERFACE_NAME, STR, interface_name),
+    CONN_FIELD(INTERFACE_TYPE, INT8, interface_type),
+    CONN_FIELD(NETWORK_ADDRESS_FAMILY, INT8, network_address_family),
+    CONN_FIELD(NETWORK_ADDRESS, STR, network_address),
+    CONN_FIELD(NETWORK_PROVIDER_TYPE, INT8, network_provider_type),
+    CONN_FIELD(NETWORK_PROVIDER, INT32, network_provider),
+    CONN_FIELD(L3_SESSION_ID, INT64, l3_session_id),
+    CONN_FIELD(L4_SESSION_ID, INT64, l4_session_id),
+    CONN_FIELD(SIGNAL_STRENGTH, INT8, signal_strength),
+    CONN_FIELD(RX_BYTES, INT64, rx_bytes),
+    CONN_FIELD(TX_BYTES, INT64, tx_bytes),
+    CONN_FIELD(HAS_IP, INT8, has_ip),
+    CONN_FIELD(CONNECTIVITY, INT8, connectivity),
+    CONN_FIELD(CONNECTION_MODE, INT8, connection_mode),
+    CONN_FIELD(QUALITY, INT8, quality),
+};
+
+#define IFACE_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_iface_event, member)
+
+static const struct md_json_field iface_fields[] = {
+    IFACE_FIELD(MD_SEQ, INT16, sequence),
+    IFACE_FIELD(TIMESTAMP, INT64, tstamp),
+    IFACE_FIELD(EVENT_PARAM, INT8, event_param),
+    IFACE_FIELD(EVENT_TYPE, INT8, event_type),
+    IFACE_FIELD(ICCID, STR, iccid),
+    IFACE_FIELD(IMSI, STR, imsi),
+    IFACE_FIELD(IMEI, STR, imei),
+    IFACE_FIELD(IP_ADDR, STR, ip_addr),
+    IFACE_FIELD(INTERNAL_IP_ADDR, STR, internal_ip_addr),
+    IFACE_FIELD(ISP_NAME, STR, isp_name),
+    IFACE_FIELD(IFNAME, STR, ifname),
+    IFACE_FIELD(IMSI_MCCMNC, INT32, imsi_mccmnc),
+    IFACE_FIELD(NETWORK_MCCMNC, INT32, nw_mccmnc),
+    IFACE_FIELD(CID, INT32, cid),
+    IFACE_FIELD(DEVICE_MODE, INT8, device_mode),
+    IFACE_FIELD(DEVICE_SUB_MODE, INT8, device_submode),
+    IFACE_FIELD(RSSI, INT8, rssi),
+    IFACE_FIELD(ECIO, INT8, ecio),
+    IFACE_FIELD(RSCP, INT16, rscp),
+    IFACE_FIELD(LTE_RSSI, INT8, lte_rssi),
+    IFACE_FIELD(LTE_RSRP, INT16, lte_rsrp),
+    IFACE_FIELD(LTE_RSRQ, INT8, lte_rsrq),
+    IFACE_FIELD(LAC, INT16, lac),
+    IFACE_FIELD(LTE_BAND, INT8, lte_band),
+    IFACE_FIELD(LTE_FREQ, INT16, lte_freq),
+    IFACE_FIELD(LTE_PCI, INT16, lte_pci),
+    IFACE_FIELD(DEVICE_STATE, INT8, device_state),
+    IFACE_FIELD(ENODEB_ID, INT32, enodeb_id),
+    //Object, exported as JSON text
+    IFACE_FIELD(CA_INFO, STR, ca_info),
+};
+
+//Fields shared by all radio events
+#define RADIO_FIELDS(s) \
+    MD_JSON_FIELD(MD_SEQ, INT16, struct s, sequence), \
+    MD_JSON_FIELD(TIMESTAMP, INT64, struct s, tstamp), \
+    MD_JSON_FIELD(EVENT_PARAM, INT8, struct s, event_param), \
+    MD_JSON_FIELD(EVENT_TYPE, INT32, struct s, md_type), \
+    MD_JSON_FIELD(ICCID, STR, struct s, iccid), \
+    MD_JSON_FIELD(IMSI, STR, struct s, imsi), \
+    MD_JSON_FIELD(IMEI, STR, struct s, imei)
+
+#define GERAN_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_radio_cell_loc_geran_event, member)
+
+static const struct md_json_field cell_loc_geran_fields[] = {
+    RADIO_FIELDS(md_radio_cell_loc_geran_event),
+    GERAN_FIELD(CELL_ID, INT32, cell_id),
+    GERAN_FIELD(PLMN, STR, plmn),
+    GERAN_FIELD(LAC, INT16, lac),
+    GERAN_FIELD(ARFCN, INT16, arfcn),
+    GERAN_FIELD(BSIC, INT8, bsic),
+    GERAN_FIELD(TIMING_ADVANCE, INT32, timing_advance),
+    GERAN_FIELD(RX_LEV, INT16, rx_lev),
+    GERAN_FIELD(CELL_GERAN_INFO_NMR, STR, cell_geran_info_nmr),
+};
+
+#define RESEL_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_radio_grr_cell_resel_event, member)
+
+static const struct md_json_field grr_cell_resel_fields[] = {
+    RADIO_FIELDS(md_radio_grr_cell_resel_event),
+    RESEL_FIELD(SERVING_BCCH_ARFCN, INT16, serving_bcch_arfcn),
+    RESEL_FIELD(SERVING_PBCCH_ARFCN, INT16, serving_pbcch_arfcn),
+    RESEL_FIELD(SERVING_PRIORITY_CLASS, INT8, serving_priority_class),
+    RESEL_FIELD(SERVING_RXLEV_AVG, INT8, serving_rxlev_avg),
+    RESEL_FIELD(SERVING_C1, INT32, serving_c1),
+    RESEL_FIELD(SERVING_C2, INT32, serving_c2),
+    RESEL_FIELD(SERVING_C31, INT32, serving_c31),
+    RESEL_FIELD(SERVING_C32, INT32, serving_c32),
+    RESEL_FIELD(SERVING_FIVE_SECOND_TIMER, INT8, serving_five_second_timer),
+    RESEL_FIELD(CELL_RESELECT_STATUS, INT8, cell_reselect_status),
+    RESEL_FIELD(RECENT_CELL_SELECTION, INT8, recent_cell_selection),
+};
+
+#define SEL_FIELD(key, member) \
+    MD_JSON_FIELD(key, INT8, struct md_radio_gsm_rr_cell_sel_reset_param_event, \
+                  member)
+
+static const struct md_json_field cell_sel_reset_param_fields[] = {
+    RADIO_FIELDS(md_radio_gsm_rr_cell_sel_reset_param_event),
+    SEL_FIELD(CELL_RESELECT_HYSTERESIS, cell_reselect_hysteresis),
+    SEL_FIELD(MS_TXPWR_MAX_CCH, ms_txpwr_max_cch),
+    SEL_FIELD(RXLEV_ACCESS_MIN, rxlev_access_min),
+    SEL_FIELD(POWER_OFFSET_VALID, power_offset_valid),
+    SEL_FIELD(POWER_OFFSET, power_offset),
+    SEL_FIELD(NECI, neci),
+    SEL_FIELD(ACS, acs),
+    SEL_FIELD(OPT_RESELECT_PARAM_IND, opt_reselect_param_ind),
+    SEL_FIELD(CELL_BAR_QUALIFY, cell_bar_qualify),
+    SEL_FIELD(CELL_RESELECT_OFFSET, cell_reselect_offset),
+    SEL_FIELD(TEMPORARY_OFFSET, temporary_offset),
+    SEL_FIELD(PENALTY_TIME, penalty_time),
+};
+
+static const struct md_json_field cipher_mode_fields[] = {
+    RADIO_FIELDS(md_radio_gsm_rr_cipher_mode_event),
+    MD_JSON_FIELD(CIPHERING_STATE, INT8,
+                  struct md_radio_gsm_rr_cipher_mode_event, ciphering_state),
+    MD_JSON_FIELD(CIPHERING_ALGORITHM, INT8,
+                  struct md_radio_gsm_rr_cipher_mode_event, ciphering_algorithm),
+};
+
+#define CHAN_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_radio_gsm_rr_channel_conf_event, member)
+
+static const struct md_json_field channel_conf_fields[] = {
+    RADIO_FIELDS(md_radio_gsm_rr_channel_conf_event),
+    CHAN_FIELD(NUM_DED_CHANS, INT8, num_ded_chans),
+    CHAN_FIELD(DTX_INDICATOR, INT8, dtx_indicator),
+    CHAN_FIELD(POWER_LEVEL, INT8, power_level),
+    CHAN_FIELD(STARTING_TIME_VALID, INT8, starting_time_valid),
+    CHAN_FIELD(STARTING_TIME, INT16, starting_time),
+    CHAN_FIELD(CIPHER_FLAG, INT8, cipher_flag),
+    CHAN_FIELD(CIPHER_ALGORITHM, INT8, cipher_algorithm),
+    CHAN_FIELD(CHANNEL_MODE_1, INT8, channel_mode_1),
+    CHAN_FIELD(CHANNEL_MODE_2, INT8, channel_mode_2),
+    CHAN_FIELD(AFTER_CHANNEL_CONFIG, STR, after_channel_config),
+    CHAN_FIELD(BEFORE_CHANNEL_CONFIG, STR, before_channel_config),
+};
+
+static const struct md_json_field wcdma_rrc_state_fields[] = {
+    RADIO_FIELDS(md_radio_wcdma_rrc_state_event),
+    MD_JSON_FIELD(RRC_STATE, INT8, struct md_radio_wcdma_rrc_state_event,
+                  rrc_state),
+};
+
+#define CELL_FIELD(key, type, member) \
+    MD_JSON_FIELD(key, type, struct md_radio_wcdma_cell_id_event, member)
+
+static const struct md_json_field wcdma_cell_id_fields[] = {
+    RADIO_FIELDS(md_radio_wcdma_cell_id_event),
+    CELL_FIELD(UL_UARFCN, INT32, ul_uarfcn),
+    CELL_FIELD(DL_UARFCN, INT32, dl_uarfcn),
+    CELL_FIELD(CELL_ID, INT32, cell_id),
+    CELL_FIELD(URA_ID, INT16, ura_id),
+    CELL_FIELD(CELL_ACCESS_REST, INT8, cell_access_rest),
+    CELL_FIELD(CALL_ACCS, INT8, call_accs),
+};
+
+#define NUM_FIELDS(fields) (sizeof(fields) / sizeof(struct md_json_field))
+
+static void* radio_parse(const struct md_json_msg *msg, struct md_slab *slab,
+                         const struct md_json_field *fields, size_t num_fields)
 {
-    json_object_object_foreach(meta_obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            mce->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            mce->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_type"))
-            mce->event_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_param"))
-            mce->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_value"))
-            mce->event_value = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "interface_id_type"))
-            mce->interface_id_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "interface_id"))
-            mce->interface_id = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            mce->imei = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            mce->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "interface_name"))
-            mce->interface_name = json_object_get_string(val);
-        else if (!strcmp(key, "interface_type"))
-            mce->interface_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "network_address_family"))
-            mce->network_address_family = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "network_address"))
-            mce->network_address = json_object_get_string(val);
-        else if (!strcmp(key, "network_provider_type"))
-            mce->network_provider_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "network_provider"))
-            mce->network_provider = json_object_get_int(val);
-        else if (!strcmp(key, "l3_session_id"))
-            mce->l3_session_id = (uint64_t) json_object_get_int64(val);
-        else if (!strcmp(key, "l4_session_id"))
-            mce->l4_session_id = (uint64_t) json_object_get_int64(val);
-        else if (!strcmp(key, "signal_strength"))
-            mce->signal_strength = (int8_t) json_object_get_int(val);
-        else if (!strcmp(key, "rx_bytes"))
-            mce->rx_bytes = (uint64_t) json_object_get_int64(val);
-        else if (!strcmp(key, "tx_bytes"))
-            mce->tx_bytes = (uint64_t) json_object_get_int64(val);
-        else if (!strcmp(key, "has_ip"))
-            mce->has_ip = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "connectivity"))
-            mce->connectivity = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "connection_mode"))
-            mce->connection_mode = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "quality"))
-            mce->quality = (uint8_t) json_object_get_int(val);
-    }
+    void *event = md_slab_alloc(slab);
+
+    if (!event)
+        return NULL;
+
+    md_json_fill(msg, fields, num_fields, event);
+    return event;
+}
+
+uint8_t parse_conn_info(const struct md_json_msg *msg, struct md_conn_event *mce, struct md_exporter *parent)
+{
+    md_json_fill(msg, conn_fields, NUM_FIELDS(conn_fields), mce);
 
     if (mce->event_param == CONN_EVENT_DATA_USAGE_UPDATE) {
         if (!mce->tstamp || !mce->event_param || !mce->interface_id || (mce->imei && !mce->imsi) ||
@@ -79,383 +218,73 @@ uint8_t parse_conn_info(struct json_object *meta_obj, struct md_conn_event *mce,
     return RETVAL_SUCCESS;
 }
 
-uint8_t parse_iface_event(struct json_object *meta_obj, struct md_iface_event *mie, struct md_exporter *parent)
+uint8_t parse_iface_event(const struct md_json_msg *msg, struct md_iface_event *mie, struct md_exporter *parent)
 {
-    json_object_object_foreach(meta_obj, key, val) {
-        if (!strcmp(key, "md_seq")) {
-            mie->sequence = (uint16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "timestamp")) {
-            mie->tstamp = json_object_get_int64(val);
-        } else if (!strcmp(key, "event_param")) {
-            mie->event_param = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "event_type")) {
-            mie->event_type = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "iccid")) {
-            mie->iccid = json_object_get_string(val);
-        } else if (!strcmp(key, "imsi")) {
-            mie->imsi = json_object_get_string(val);
-        } else if (!strcmp(key, "imei")) {
-            mie->imei = json_object_get_string(val);
-        } else if (!strcmp(key, "ip_addr")) {
-            mie->ip_addr = json_object_get_string(val);
-        } else if (!strcmp(key, "internal_ip_addr")) {
-            mie->internal_ip_addr = json_object_get_string(val);
-        } else if (!strcmp(key, "isp_name")) {
-            mie->isp_name = json_object_get_string(val);
-        } else if (!strcmp(key, "ifname")) {
-            mie->ifname = json_object_get_string(val);
-        } else if (!strcmp(key, "imsi_mccmnc")) {
-            mie->imsi_mccmnc = (uint32_t) json_object_get_int(val);
-        } else if (!strcmp(key, "network_mccmnc")) {
-            mie->nw_mccmnc = (uint32_t) json_object_get_int(val);
-        } else if (!strcmp(key, "cid")) {
-            mie->cid = json_object_get_int(val);
-        } else if (!strcmp(key, "device_mode")) {
-            mie->device_mode = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "device_sub_mode")) {
-            mie->device_submode = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "rssi")) {
-            mie->rssi = (int8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "ecio")) {
-            mie->ecio = (int8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "rscp")) {
-            mie->rscp = (int16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_rssi")) {
-            mie->lte_rssi = (int8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_rsrp")) {
-            mie->lte_rsrp = (int16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_rsrq")) {
-            mie->lte_rsrq = (int8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lac")) {
-            mie->lac = (uint16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_band")) {
-            mie->lte_band = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_freq")) {
-            mie->lte_freq = (uint16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "lte_pci")) {
-            mie->lte_pci = (uint16_t) json_object_get_int(val);
-        } else if (!strcmp(key, "device_state")) {
-            mie->device_state = (uint8_t) json_object_get_int(val);
-        } else if (!strcmp(key, "enodeb_id")) {
-            mie->enodeb_id = json_object_get_int(val);
-        } else if (!strcmp(key, "ca_info")) {
-            mie->ca_info = json_object_to_json_string_ext(val, JSON_C_TO_STRING_PLAIN);
-        }
-    }
-
+    md_json_fill(msg, iface_fields, NUM_FIELDS(iface_fields), mie);
     return RETVAL_SUCCESS;
 }
 
-struct md_radio_cell_loc_geran_event * radio_cell_loc_geran(json_object *obj)
+struct md_radio_cell_loc_geran_event * radio_cell_loc_geran(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_cell_loc_geran_event *event = calloc(sizeof(struct md_radio_cell_loc_geran_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "cell_id"))
-            event->cell_id = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "plmn"))
-            event->plmn = json_object_get_string(val);
-        else if (!strcmp(key, "lac"))
-            event->lac = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "arfcn"))
-            event->arfcn = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "bsic"))
-            event->bsic = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "timing_advance"))
-            event->timing_advance = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "rx_lev"))
-            event->rx_lev = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_geran_info_nmr"))
-            event->cell_geran_info_nmr = json_object_to_json_string_ext(val, JSON_C_TO_STRING_PLAIN);
-    }
-
-    return event;
+    return radio_parse(msg, slab, cell_loc_geran_fields,
+                       NUM_FIELDS(cell_loc_geran_fields));
 }
 
-struct md_radio_grr_cell_resel_event* radio_grr_cell_resel(json_object* obj)
+struct md_radio_grr_cell_resel_event* radio_grr_cell_resel(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_grr_cell_resel_event *event = calloc(sizeof(struct md_radio_grr_cell_resel_event), 1);
-    struct json_object *obj_tmp;
-    uint8_t neigh_count = 0;
+    struct md_radio_grr_cell_resel_event *event;
+    const struct md_json_value *neighbors;
+
+    event = radio_parse(msg, slab, grr_cell_resel_fields,
+                        NUM_FIELDS(grr_cell_resel_fields));
 
     if (!event)
         return NULL;
 
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "serving_bcch_arfcn"))
-            event->serving_bcch_arfcn = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_pbcch_arfcn"))
-            event->serving_pbcch_arfcn = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_priority_class"))
-            event->serving_priority_class = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_rxlev_avg"))
-            event->serving_rxlev_avg = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_c1"))
-            event->serving_c1 = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_c2"))
-            event->serving_c2 = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_c31"))
-            event->serving_c31 = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_c32"))
-            event->serving_c32 = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "serving_five_second_timer"))
-            event->serving_five_second_timer = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_reselect_status"))
-            event->cell_reselect_status = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "recent_cell_selection"))
-            event->recent_cell_selection = (uint8_t) json_object_get_int(val);
-    }
-
-    json_object_object_get_ex(obj, "neighbor_cell_count", &obj_tmp);
-
-    if (obj_tmp)
-        neigh_count = json_object_get_int(obj_tmp);
-
-    if (neigh_count) {
-        json_object_object_get_ex(obj, "grr_cell_neighbor", &obj_tmp);
-
-        if (obj_tmp)
-            event->neighbors = json_object_to_json_string_ext(obj_tmp, JSON_C_TO_STRING_PLAIN);
-    }
+    if (md_json_get_int(msg, MD_JSON_KEY_NEIGHBOR_CELL_COUNT, 0) &&
+        (neighbors = md_json_get(msg, MD_JSON_KEY_GRR_CELL_NEIGHBOR)))
+        event->neighbors = neighbors->str;
 
     return event;
 }
 
-struct md_radio_gsm_rr_cell_sel_reset_param_event* radio_gsm_rr_cell_sel_reset_param(json_object *obj)
+struct md_radio_gsm_rr_cell_sel_reset_param_event* radio_gsm_rr_cell_sel_reset_param(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_gsm_rr_cell_sel_reset_param_event *event = calloc(sizeof(struct md_radio_gsm_rr_cell_sel_reset_param_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "cell_reselect_hysteresis"))
-            event->cell_reselect_hysteresis = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "ms_txpwr_max_cch"))
-            event->ms_txpwr_max_cch = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "rxlev_access_min"))
-            event->rxlev_access_min = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "power_offset_valid"))
-            event->power_offset_valid = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "power_offset"))
-            event->power_offset = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "neci"))
-            event->neci = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "acs"))
-            event->acs = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "opt_reselect_param_ind"))
-            event->opt_reselect_param_ind = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_bar_qualify"))
-            event->cell_bar_qualify = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_reselect_offset"))
-            event->cell_reselect_offset = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "temporary_offset"))
-            event->temporary_offset = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "penalty_time"))
-            event->penalty_time = (uint8_t) json_object_get_int(val);
-    }
-
-    return event;
+    return radio_parse(msg, slab, cell_sel_reset_param_fields,
+                       NUM_FIELDS(cell_sel_reset_param_fields));
 }
 
-struct md_radio_gsm_rr_cipher_mode_event* radio_gsm_rr_cipher_mode(json_object *obj)
+struct md_radio_gsm_rr_cipher_mode_event* radio_gsm_rr_cipher_mode(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_gsm_rr_cipher_mode_event *event = calloc(sizeof(struct md_radio_gsm_rr_cipher_mode_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "ciphering_state"))
-            event->ciphering_state = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "ciphering_algorithm"))
-            event->ciphering_algorithm = (uint8_t) json_object_get_int(val);
-    }
-
-    return event;
+    return radio_parse(msg, slab, cipher_mode_fields,
+                       NUM_FIELDS(cipher_mode_fields));
 }
 
-struct md_radio_gsm_rr_channel_conf_event* radio_gsm_rr_channel_conf(json_object *obj)
+struct md_radio_gsm_rr_channel_conf_event* radio_gsm_rr_channel_conf(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_gsm_rr_channel_conf_event *event = calloc(sizeof(struct md_radio_gsm_rr_channel_conf_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "num_ded_chans;"))
-            event->num_ded_chans = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "dtx_indicator"))
-            event->dtx_indicator = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "power_level"))
-            event->power_level = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "starting_time_valid"))
-            event->starting_time_valid = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "starting_time"))
-            event->starting_time = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "cipher_flag"))
-            event->cipher_flag = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "cipher_algorithm"))
-            event->cipher_algorithm = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "channel_mode_1"))
-            event->channel_mode_1 = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "channel_mode_2"))
-            event->channel_mode_2 = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "after_channel_config"))
-            event->after_channel_config = json_object_get_string(val);
-        else if (!strcmp(key, "before_channel_config"))
-            event->before_channel_config = json_object_get_string(val);
-    }
-
-    return event;
+    return radio_parse(msg, slab, channel_conf_fields,
+                       NUM_FIELDS(channel_conf_fields));
 }
 
-struct md_radio_wcdma_rrc_state_event* radio_wcdma_rrc_state(json_object *obj)
+struct md_radio_wcdma_rrc_state_event* radio_wcdma_rrc_state(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_wcdma_rrc_state_event *event = calloc(sizeof(struct md_radio_wcdma_rrc_state_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "rrc_state"))
-            event->rrc_state = (uint8_t) json_object_get_int(val);
-    }
-
-    return event;
+    return radio_parse(msg, slab, wcdma_rrc_state_fields,
+                       NUM_FIELDS(wcdma_rrc_state_fields));
 }
 
-struct md_radio_wcdma_cell_id_event* radio_wcdma_cell_id(json_object *obj)
+struct md_radio_wcdma_cell_id_event* radio_wcdma_cell_id(const struct md_json_msg *msg, struct md_slab *slab)
 {
-    struct md_radio_wcdma_cell_id_event *event = calloc(sizeof(struct md_radio_wcdma_cell_id_event), 1);
-
-    if (!event)
-        return NULL;
-
-    json_object_object_foreach(obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            event->sequence = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "timestamp"))
-            event->tstamp = json_object_get_int64(val);
-        else if (!strcmp(key, "event_param"))
-            event->event_param = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "event_type"))
-            event->md_type = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "iccid"))
-            event->iccid = json_object_get_string(val);
-        else if (!strcmp(key, "imsi"))
-            event->imsi = json_object_get_string(val);
-        else if (!strcmp(key, "imei"))
-            event->imei = json_object_get_string(val);
-        else if (!strcmp(key, "ul_uarfcn"))
-            event->ul_uarfcn = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "dl_uarfcn"))
-            event->dl_uarfcn = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_id"))
-            event->cell_id = (uint32_t) json_object_get_int(val);
-        else if (!strcmp(key, "ura_id"))
-            event->ura_id = (uint16_t) json_object_get_int(val);
-        else if (!strcmp(key, "cell_access_rest"))
-            event->cell_access_rest = (uint8_t) json_object_get_int(val);
-        else if (!strcmp(key, "call_accs"))
-            event->dl_uarfcn = (uint8_t) json_object_get_int(val);
-    }
-
-    return event;
+    return radio_parse(msg, slab, wcdma_cell_id_fields,
+                       NUM_FIELDS(wcdma_cell_id_fields));
 }
 
-struct md_gps_event* handle_gps_event(struct json_object *json_obj)
+struct md_gps_event* handle_gps_event(const struct md_json_msg *msg,
+                                      struct md_slab *slab)
 {
+    const struct md_json_value *nmea;
     int8_t sentence_id = 0;
 
-    struct md_gps_event *gps_event = calloc(sizeof(struct md_gps_event), 1);
+    struct md_gps_event *gps_event = md_slab_alloc(slab);
 
     if (!gps_event)
         return NULL;
@@ -466,21 +295,15 @@ struct md_gps_event* handle_gps_event(struct json_object *json_obj)
     } gps;
 
     gps_event->md_type = META_TYPE_POS;
+    gps_event->sequence = (uint16_t) md_json_get_int(msg, MD_JSON_KEY_MD_SEQ, 0);
+    gps_event->tstamp_tv.tv_sec = md_json_get_int(msg, MD_JSON_KEY_TIMESTAMP, 0);
 
-    json_object_object_foreach(json_obj, key, val) {
-        if (!strcmp(key, "md_seq"))
-            gps_event->sequence = (uint16_t) json_object_get_int(val);
-
-        if (!strcmp(key, "timestamp"))
-            gps_event->tstamp_tv.tv_sec = json_object_get_int64(val);
-
-        if (!strcmp(key, "nmea_string"))
-            gps_event->nmea_raw = json_object_get_string(val);
-    }
+    if ((nmea = md_json_get(msg, MD_JSON_KEY_NMEA_STRING)))
+        gps_event->nmea_raw = nmea->str;
 
     if (!gps_event->sequence || !gps_event->nmea_raw)
     {
-        free(gps_event);
+        md_slab_free(slab, gps_event);
         return NULL;
     }
 
@@ -488,7 +311,7 @@ struct md_gps_event* handle_gps_event(struct json_object *json_obj)
 
     if (sentence_id <= 0)
     {
-        free(gps_event);
+        md_slab_free(slab, gps_event);
         return NULL;
     }
 
@@ -498,7 +321,7 @@ struct md_gps_event* handle_gps_event(struct json_object *json_obj)
     switch (sentence_id) {
     case MINMEA_SENTENCE_GGA:
         if (minmea_parse_gga(&gps.gga, gps_event->nmea_raw) && !gps.gga.fix_quality) {
-            free(gps_event);
+            md_slab_free(slab, gps_event);
             return NULL;
         } else {
             gps_event->time = gps.gga.time;
@@ -510,7 +333,7 @@ struct md_gps_event* handle_gps_event(struct json_object *json_obj)
         break;
     case MINMEA_SENTENCE_RMC:
         if (minmea_parse_rmc(&gps.rmc, gps_event->nmea_raw) && !gps.rmc.valid) {
-            free(gps_event);
+            md_slab_free(slab, gps_event);
             return NULL;
         } else {
             gps_event->time = gps.rmc.time;
@@ -520,27 +343,13 @@ struct md_gps_event* handle_gps_event(struct json_object *json_obj)
         }
         break;
     default:
-        free(gps_event);
+        md_slab_free(slab, gps_event);
         return NULL;
     }
 
     return gps_event;
 }
 
-uint8_t add_json_key_value(const char *key,
-                           int32_t value, struct json_object *obj)
-{
-    struct json_object *obj_add = NULL;
-    obj_add = json_object_new_int(value);
-
-    if (!obj_add)
-        return RETVAL_FAILURE;
-
-    json_object_object_add(obj, key, obj_add);
-
-    return RETVAL_SUCCESS;
-}
-
 void init_iface_event(struct md_iface_event *mie)
 {
     memset(mie, 0, sizeof(struct md_iface_event));
@@ -2,18 +2,34 @@
 #define METADATA_INPUT_NL_ZMQ_COMMON
 
 #include "metadata_exporter.h"
+#include "metadata_slab.h"
+#include "metadata_json_stream.h"
 
-uint8_t parse_conn_info(struct json_object *meta_obj, struct md_conn_event *mce, struct md_exporter *parent);
-uint8_t parse_iface_event(struct json_object *meta_obj, struct md_iface_event *mie, struct md_exporter *parent);
-struct md_radio_cell_loc_geran_event* radio_cell_loc_geran(json_object *obj);
-struct md_radio_grr_cell_resel_event* radio_grr_cell_resel(json_object *obj);
-struct md_radio_gsm_rr_cell_sel_reset_param_event* radio_gsm_rr_cell_sel_reset_param(json_object *obj);
-struct md_radio_gsm_rr_cipher_mode_event* radio_gsm_rr_cipher_mode(json_object *obj);
-struct md_radio_gsm_rr_channel_conf_event* radio_gsm_rr_channel_conf(json_object *obj);
-struct md_radio_wcdma_rrc_state_event* radio_wcdma_rrc_state(json_object *obj);
-struct md_radio_wcdma_cell_id_event* radio_wcdma_cell_id(json_object *obj);
-struct md_gps_event* handle_gps_event(struct json_object *json_obj);
-uint8_t add_json_key_value(const char *key, int32_t value, struct json_object *obj);
+//Events returned by the parsers below are allocated from the input's slab,
+//which must be created with (at least) this object size. The events are
+//released with md_slab_free() once published
+union md_nl_zmq_event {
+    struct md_radio_cell_loc_geran_event cell_loc_geran;
+    struct md_radio_grr_cell_resel_event grr_cell_resel;
+    struct md_radio_gsm_rr_cell_sel_reset_param_event cell_sel_reset_param;
+    struct md_radio_gsm_rr_cipher_mode_event cipher_mode;
+    struct md_radio_gsm_rr_channel_conf_event channel_conf;
+    struct md_radio_wcdma_rrc_state_event wcdma_rrc_state;
+    struct md_radio_wcdma_cell_id_event wcdma_cell_id;
+    struct md_gps_event gps;
+};
+
+uint8_t parse_conn_info(const struct md_json_msg *msg, struct md_conn_event *mce, struct md_exporter *parent);
+uint8_t parse_iface_event(const struct md_json_msg *msg, struct md_iface_event *mie, struct md_exporter *parent);
+struct md_radio_cell_loc_geran_event* radio_cell_loc_geran(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_grr_cell_resel_event* radio_grr_cell_resel(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_gsm_rr_cell_sel_reset_param_event* radio_gsm_rr_cell_sel_reset_param(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_gsm_rr_cipher_mode_event* radio_gsm_rr_cipher_mode(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_gsm_rr_channel_conf_event* radio_gsm_rr_channel_conf(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_wcdma_rrc_state_event* radio_wcdma_rrc_state(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_radio_wcdma_cell_id_event* radio_wcdma_cell_id(const struct md_json_msg *msg, struct md_slab *slab);
+struct md_gps_event* handle_gps_event(const struct md_json_msg *msg,
+                                      struct md_slab *slab);
 void init_iface_event(struct md_iface_event *mie);
 void init_conn_event(struct md_conn_event *mce);
 #endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <sys/time.h>
 #include <sys/timerfd.h>
@@ -16,6 +17,7 @@
 #include "metadata_exporter.h"
 #include "metadata_input_sysevent.h"
 #include "backend_event_loop.h"
+#include "metadata_exporter_log.h"
 
 /* TODO
 - clean header list
@@ -45,12 +47,18 @@ static void md_input_sysevent_handle_event(void *ptr, int32_t fd, uint32_t event
 
     int zevents = 0;
     size_t zevents_len = sizeof(zevents);
+    md_input_budget_start(&(mis->budget));
     zmq_getsockopt(mis->responder, ZMQ_EVENTS, &zevents, &zevents_len);
 
     if (!(zevents & ZMQ_POLLIN)) return;
 
     json_tokener *tok = json_tokener_new();
     do {
+        if (md_input_budget_spent(&(mis->budget))) {
+            md_input_budget_yield(&(mis->budget), mis->event_loop);
+            break;
+        }
+
         int nbytes = zmq_recv(mis->responder, &buffer, 8192, ZMQ_NOBLOCK);
         if (nbytes>=sizeof(buffer)) break;
 
@@ -81,6 +89,14 @@ static void md_input_sysevent_handle_event(void *ptr, int32_t fd, uint32_t event
     json_tokener_free(tok);
 }
 
+//Called from the budget task, when the handler yielded with messages left
+static void md_input_sysevent_resume(void *ptr)
+{
+    struct md_input_sysevent *mis = ptr;
+
+    md_input_sysevent_handle_event(mis, mis->zmq_fd, EPOLLIN);
+}
+
 static uint8_t md_sysevent_config(struct md_input_sysevent *mis)
 {
     if (md_sysevent_reconnect(mis) == RETVAL_SUCCESS) {
@@ -88,8 +104,9 @@ static uint8_t md_sysevent_config(struct md_input_sysevent *mis)
                                mis, mis->zmq_fd , md_input_sysevent_handle_event)))
         return RETVAL_FAILURE;
 
+      mis->event_handle->name = "sysevent";
       backend_event_loop_update(
-          mis->parent->event_loop, EPOLLIN, EPOLL_CTL_ADD, mis->zmq_fd, mis->event_handle);
+          mis->event_loop, EPOLLIN | EPOLLET, EPOLL_CTL_ADD, mis->zmq_fd, mis->event_handle);
 
       return RETVAL_SUCCESS;
     }
@@ -99,21 +116,48 @@ static uint8_t md_sysevent_config(struct md_input_sysevent *mis)
 static uint8_t md_input_sysevent_init(void *ptr, json_object* config)
 {
     struct md_input_sysevent *mis = ptr;
+    json_object *subconfig;
+
+    md_input_budget_init(&(mis->budget), md_input_sysevent_resume, mis,
+            "sysevent resume");
+
+    if (json_object_object_get_ex(config, "sysevent", &subconfig)) {
+        json_object_object_foreach(subconfig, key, val)
+            md_input_budget_config(&(mis->budget), key, val);
+    }
+
     return md_sysevent_config(mis);
 }
 
 void md_sysevent_usage()
 {
-    fprintf(stderr, "\"sysevent\": {},\t\tSysevent input (no parameters)\n");
+    fprintf(stderr, "\"sysevent\": {\t\tSysevent input\n");
+    md_input_budget_usage();
+    fprintf(stderr, "},\n");
 }
 
 static void md_input_sysevent_destroy()
 {
 }
 
+static void md_input_sysevent_log_stats(void *ptr)
+{
+    struct md_input_sysevent *mis = ptr;
+    uint64_t yields = mis->budget.yields;
+
+    if (yields == mis->budget.last_yields)
+        return;
+
+    META_PRINT_SYSLOG(mis->parent, LOG_INFO, "Sysevent input yielded %" PRIu64
+            " times (+%" PRIu64 ") due to budget\n", yields,
+            yields - mis->budget.last_yields);
+    mis->budget.last_yields = yields;
+}
+
 void md_sysevent_setup(struct md_exporter *mde, struct md_input_sysevent *mis)
 {
     mis->parent  = mde;
     mis->init    = md_input_sysevent_init;
     mis->destroy = md_input_sysevent_destroy;
+    mis->log_stats = md_input_sysevent_log_stats;
 }
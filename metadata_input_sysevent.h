@@ -3,6 +3,7 @@
 #include <uv.h>
 
 #include "metadata_exporter.h"
+#include "metadata_input_budget.h"
 
 struct backend_epoll_handle;
 
@@ -12,6 +13,7 @@ struct md_input_sysevent {
     void* responder;
     char* message;
     int zmq_fd;
+    struct md_input_budget budget;
 };
 
 void md_sysevent_setup(struct md_exporter *mde, struct md_input_sysevent *mis);
@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <libmnl/libmnl.h>
@@ -37,163 +38,181 @@
 #include "metadata_exporter.h"
 #include "metadata_input_nl_zmq_common.h"
 #include "metadata_input_zeromq.h"
+#include "metadata_event.h"
+#include "metadata_msgpack.h"
 #include "backend_event_loop.h"
 
 #include "lib/minmea.h"
 #include "metadata_exporter_log.h"
 
-static void md_input_zeromq_handle_iface_event(struct md_input_zeromq *miz,
-        struct json_object *obj)
+//Received message. Events point into the message data, and the writers keep
+//the message alive through the backing until they are done with the events
+struct md_input_zeromq_msg {
+    struct md_event_backing backing;
+    //Pool of the worker that received the message
+    struct md_slab *pool;
+    zmq_msg_t msg;
+};
+
+//Events point into the message being handled, which is shared with the writers
+static void md_input_zeromq_publish(struct md_input_zeromq_worker *mzw,
+                                    struct md_event *event)
 {
-    init_iface_event(miz->mie);
+    mde_publish_event_backed(mzw->parent, event, &(mzw->cur_msg->backing),
+            mzw->cur_origin, &(mzw->clone_pool));
+}
+
+static void md_input_zeromq_handle_iface_event(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
+{
+    init_iface_event(mzw->mie);
 
-    if (parse_iface_event(obj, miz->mie, miz->parent) == RETVAL_FAILURE)
+    if (parse_iface_event(msg, mzw->mie, mzw->parent) == RETVAL_FAILURE)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) miz->mie);
+    md_input_zeromq_publish(mzw, (struct md_event*) mzw->mie);
 }
 
-static void md_input_zeromq_handle_conn_event(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_handle_conn_event(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
     uint8_t retval = 0;
 
-    init_conn_event(miz->mce);
-    retval = parse_conn_info(obj, miz->mce, miz->parent);
+    init_conn_event(mzw->mce);
+    retval = parse_conn_info(msg, mzw->mce, mzw->parent);
 
     if (retval == RETVAL_FAILURE)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) miz->mce);
+    md_input_zeromq_publish(mzw, (struct md_event*) mzw->mce);
 }
 
-static void md_input_zeromq_radio_cell_loc_geran(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_cell_loc_geran(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    struct md_radio_cell_loc_geran_event * event = radio_cell_loc_geran(obj);
+    struct md_radio_cell_loc_geran_event * event = radio_cell_loc_geran(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_grr_cell_resel(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_grr_cell_resel(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    struct md_radio_grr_cell_resel_event *event = radio_grr_cell_resel(obj);
+    struct md_radio_grr_cell_resel_event *event = radio_grr_cell_resel(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_gsm_rr_cell_sel_reset_param(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_gsm_rr_cell_sel_reset_param(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    struct md_radio_gsm_rr_cell_sel_reset_param_event *event = radio_gsm_rr_cell_sel_reset_param(obj);
+    struct md_radio_gsm_rr_cell_sel_reset_param_event *event = radio_gsm_rr_cell_sel_reset_param(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_gsm_rr_cipher_mode(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_gsm_rr_cipher_mode(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-   struct md_radio_gsm_rr_cipher_mode_event *event = radio_gsm_rr_cipher_mode(obj);
+   struct md_radio_gsm_rr_cipher_mode_event *event = radio_gsm_rr_cipher_mode(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_gsm_rr_channel_conf(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_gsm_rr_channel_conf(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    struct md_radio_gsm_rr_channel_conf_event* event = radio_gsm_rr_channel_conf(obj);
+    struct md_radio_gsm_rr_channel_conf_event* event = radio_gsm_rr_channel_conf(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_wcdma_rrc_state(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_wcdma_rrc_state(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-   struct md_radio_wcdma_rrc_state_event *event = radio_wcdma_rrc_state(obj);
+   struct md_radio_wcdma_rrc_state_event *event = radio_wcdma_rrc_state(msg, &(mzw->event_slab));
 
    if (!event)
        return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_radio_wcdma_cell_id(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_radio_wcdma_cell_id(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    struct md_radio_wcdma_cell_id_event *event = radio_wcdma_cell_id(obj);
+    struct md_radio_wcdma_cell_id_event *event = radio_wcdma_cell_id(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event*) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_handle_radio_event(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_handle_radio_event(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
-    json_object *event_param_json;
     uint8_t event_param;
 
-    if (!json_object_object_get_ex(obj, "event_param", &event_param_json)) {
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Missing event type\n");
+    if (!md_json_get(msg, MD_JSON_KEY_EVENT_PARAM)) {
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "Missing event type\n");
         return;
     }
 
-    memset(miz->mre, 0, sizeof(struct md_radio_event));
-    miz->mre->md_type = META_TYPE_RADIO;
-    event_param = (uint8_t) json_object_get_int(event_param_json);
+    memset(mzw->mre, 0, sizeof(struct md_radio_event));
+    mzw->mre->md_type = META_TYPE_RADIO;
+    event_param = (uint8_t) md_json_get_int(msg, MD_JSON_KEY_EVENT_PARAM, 0);
 
     switch (event_param) {
     case RADIO_EVENT_GSM_RR_CIPHER_MODE:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "GSM_RR_CIPHER_MODE\n");
-        md_input_zeromq_radio_gsm_rr_cipher_mode(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "GSM_RR_CIPHER_MODE\n");
+        md_input_zeromq_radio_gsm_rr_cipher_mode(mzw, msg);
         break;
     case RADIO_EVENT_GSM_RR_CHANNEL_CONF:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "GSM_RR_CHANNEL_CONF\n");
-        md_input_zeromq_radio_gsm_rr_channel_conf(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "GSM_RR_CHANNEL_CONF\n");
+        md_input_zeromq_radio_gsm_rr_channel_conf(mzw, msg);
         break;
     case RADIO_EVENT_CELL_LOCATION_GERAN:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "CELL_LOCATION_GERAN\n");
-        md_input_zeromq_radio_cell_loc_geran(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "CELL_LOCATION_GERAN\n");
+        md_input_zeromq_radio_cell_loc_geran(mzw, msg);
         break;
     case RADIO_EVENT_GSM_RR_CELL_SEL_RESEL_PARAM:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "GSM_RR_CELL_SEL_RESEL_PARAM\n");
-        md_input_zeromq_radio_gsm_rr_cell_sel_reset_param(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "GSM_RR_CELL_SEL_RESEL_PARAM\n");
+        md_input_zeromq_radio_gsm_rr_cell_sel_reset_param(mzw, msg);
         break;
     case RADIO_EVENT_GRR_CELL_RESEL:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "GRR_CELL_RESEL\n");
-        md_input_zeromq_radio_grr_cell_resel(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "GRR_CELL_RESEL\n");
+        md_input_zeromq_radio_grr_cell_resel(mzw, msg);
         break;
     case RADIO_EVENT_WCDMA_RRC_STATE:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "WCDMA_RRC_STATE\n");
-        md_input_zeromq_radio_wcdma_rrc_state(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "WCDMA_RRC_STATE\n");
+        md_input_zeromq_radio_wcdma_rrc_state(mzw, msg);
         break;
     case RADIO_EVENT_WCDMA_CELL_ID:
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "WCDMA_CELL_ID\n");
-        md_input_zeromq_radio_wcdma_cell_id(miz, obj);
+        META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "WCDMA_CELL_ID\n");
+        md_input_zeromq_radio_wcdma_cell_id(mzw, msg);
         break;
 
     default:
@@ -201,228 +220,579 @@ static void md_input_zeromq_handle_radio_event(struct md_input_zeromq *miz,
     }
 }
 
-static void md_input_zeromq_handle_gps_event(struct md_input_zeromq *miz,
-                                              struct json_object *json_obj)
+static void md_input_zeromq_handle_gps_event(struct md_input_zeromq_worker *mzw,
+                                              const struct md_json_msg *msg)
 {
-    struct md_gps_event* event = handle_gps_event(json_obj);
+    struct md_gps_event* event = handle_gps_event(msg, &(mzw->event_slab));
 
     if (!event)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event *) event);
-    free(event);
+    md_input_zeromq_publish(mzw, (struct md_event *) event);
+    md_slab_free(&(mzw->event_slab), event);
 }
 
-static void md_input_zeromq_handle_system_event(struct md_input_zeromq *miz,
-        struct json_object *obj)
+static void md_input_zeromq_handle_system_event(struct md_input_zeromq_worker *mzw,
+        const struct md_json_msg *msg)
 {
     //recycle iface event, it contains all fields we need (currently)
-    memset(miz->mse, 0, sizeof(md_system_event_t));
-    miz->mse->md_type = META_TYPE_SYSTEM;
+    memset(mzw->mse, 0, sizeof(md_system_event_t));
+    mzw->mse->md_type = META_TYPE_SYSTEM;
 
-    if (parse_iface_event(obj, miz->mse, miz->parent) == RETVAL_FAILURE)
+    if (parse_iface_event(msg, mzw->mse, mzw->parent) == RETVAL_FAILURE)
         return;
 
-    mde_publish_event_obj(miz->parent, (struct md_event*) miz->mse);
+    md_input_zeromq_publish(mzw, (struct md_event*) mzw->mse);
 }
 
-static int subscribe_for_topic(const char* topic, struct md_input_zeromq *miz)
+//Topics published by the NL and DLB publishers. We only subscribe to the
+//topics of the configured event types, so that all other messages are dropped
+//by libzmq before they are parsed
+struct md_input_zeromq_topic {
+    uint32_t md_type;
+    const char *endpoint;
+    const char *topic;
+};
+
+static const struct md_input_zeromq_topic md_input_zeromq_topics[] = {
+    {META_TYPE_INTERFACE, ZMQ_NL_ENDPOINT, ZMQ_NL_INTERFACE_TOPIC},
+    {META_TYPE_RADIO, ZMQ_NL_ENDPOINT, ZMQ_NL_RADIOEVENT_TOPIC},
+    {META_TYPE_POS, ZMQ_NL_ENDPOINT, ZMQ_NL_GPS_TOPIC},
+    {META_TYPE_SYSTEM, ZMQ_NL_ENDPOINT, ZMQ_NL_SYSTEMEVENT_TOPIC},
+    {META_TYPE_CONNECTION, ZMQ_DLB_ENDPOINT, ZMQ_DLB_METADATA_TOPIC},
+    {META_TYPE_CONNECTION, ZMQ_DLB_ENDPOINT, ZMQ_DLB_DATAUSAGE_TOPIC},
+};
+
+#define MD_INPUT_ZEROMQ_NUM_TOPICS \
+    (sizeof(md_input_zeromq_topics) / sizeof(struct md_input_zeromq_topic))
+
+static uint8_t md_input_zeromq_connect(struct md_input_zeromq *miz,
+                                       struct md_input_zeromq_sock *sock,
+                                       const char *endpoint)
 {
-    size_t len = strlen(topic);
-    return zmq_setsockopt(miz->zmq_socket, ZMQ_SUBSCRIBE, topic, len);
+    if (zmq_connect(sock->zmq_socket, endpoint) == -1) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't connect to ZMQ "
+                "publisher %s: %s\n", endpoint, zmq_strerror(zmq_errno()));
+        return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
 }
 
-static void md_input_zeromq_handle_event(void *ptr, int32_t fd, uint32_t events)
+//Connect to every local endpoint publishing one of the types in md_zmq_mask
+static uint8_t md_input_zeromq_connect_local(struct md_input_zeromq *miz,
+                                             struct md_input_zeromq_sock *sock)
 {
-    struct md_input_zeromq *miz = ptr;
-    int zmq_events = 0;
-    size_t events_len = sizeof(zmq_events);
-    json_object *json_event = NULL, *zmqh_obj = NULL;
-    const char *json_msg = NULL, *json_str;
-    uint8_t event_type = 0;
+    const struct md_input_zeromq_topic *topic;
+    uint32_t endpoint_mask;
+    size_t i, j;
 
-    zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
+    for (i = 0; i < MD_INPUT_ZEROMQ_NUM_TOPICS; i++) {
+        topic = &md_input_zeromq_topics[i];
 
-    while (zmq_events & ZMQ_POLLIN)
-    {
-        char buf[2048] = {0};
-        int nbytes = zmq_recv(miz->zmq_socket, buf, 2047, 0);
-
-        if (nbytes == -1) {
-            zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
+        if (!(topic->md_type & miz->md_zmq_mask))
             continue;
+
+        //Only connect on the first wanted topic of an endpoint
+        for (j = 0, endpoint_mask = 0; j < i; j++) {
+            if (!strcmp(md_input_zeromq_topics[j].endpoint, topic->endpoint))
+                endpoint_mask |= md_input_zeromq_topics[j].md_type;
         }
 
-        //Ensure zero teminated string, in case zmq does something funky with buffer
-        buf[nbytes] = '\0';
+        if (!(endpoint_mask & miz->md_zmq_mask) &&
+            md_input_zeromq_connect(miz, sock, topic->endpoint))
+            return RETVAL_FAILURE;
+    }
 
-        json_msg = strchr(buf, '{');
-        if (json_msg == NULL) {
-            zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
-            continue;
+    return RETVAL_SUCCESS;
+}
+
+//A node publishes all topics, endpoints is a string or an array of strings
+static uint8_t md_input_zeromq_connect_node(struct md_input_zeromq *miz,
+                                            struct md_input_zeromq_sock *sock,
+                                            json_object *endpoints)
+{
+    json_object *endpoint;
+    int i;
+
+    if (json_object_is_type(endpoints, json_type_string))
+        return md_input_zeromq_connect(miz, sock,
+                json_object_get_string(endpoints));
+
+    if (!json_object_is_type(endpoints, json_type_array) ||
+        !json_object_array_length(endpoints)) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Invalid endpoint(s) for node "
+                "%s\n", sock->origin);
+        return RETVAL_FAILURE;
+    }
+
+    for (i = 0; i < json_object_array_length(endpoints); i++) {
+        endpoint = json_object_array_get_idx(endpoints, i);
+
+        if (!json_object_is_type(endpoint, json_type_string)) {
+            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Invalid endpoint for "
+                    "node %s\n", sock->origin);
+            return RETVAL_FAILURE;
         }
 
-        zmqh_obj = json_tokener_parse(json_msg);
-        if (!zmqh_obj) {
-            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Received invalid JSON object on ZMQ socket\n");
-            zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
+        if (md_input_zeromq_connect(miz, sock, json_object_get_string(endpoint)))
+            return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+//Subscribe to the topics of the types in md_zmq_mask
+static uint8_t md_input_zeromq_subscribe(struct md_input_zeromq *miz,
+                                         struct md_input_zeromq_sock *sock)
+{
+    const struct md_input_zeromq_topic *topic;
+    size_t i;
+
+    for (i = 0; i < MD_INPUT_ZEROMQ_NUM_TOPICS; i++) {
+        topic = &md_input_zeromq_topics[i];
+
+        if (!(topic->md_type & miz->md_zmq_mask))
             continue;
+
+        if (zmq_setsockopt(sock->zmq_socket, ZMQ_SUBSCRIBE, topic->topic,
+                    strlen(topic->topic)) == -1) {
+            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't subscribe to %s: "
+                    "%s\n", topic->topic, zmq_strerror(zmq_errno()));
+            return RETVAL_FAILURE;
         }
+    }
 
-        //We are inserting version and sequence number. Version is so that the
-        //application handling this data knows if it supports the format or not.
-        //Sequence is so that we can see the order in which events arrived at the
-        //metadata exporter, making it easier to correlate events between
-        //applications. The different applications publishing data might also insert
-        //their own sequence number
-        if (add_json_key_value("md_seq", mde_inc_seq(miz->parent), zmqh_obj) ||
-            add_json_key_value("md_ver", MDE_VERSION, zmqh_obj)) {
-            json_object_put(zmqh_obj);
-            zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
-            continue;
+    return RETVAL_SUCCESS;
+}
+
+static void md_input_zeromq_msg_release(struct md_event_backing *backing)
+{
+    struct md_input_zeromq_msg *zmsg = (struct md_input_zeromq_msg*) backing;
+
+    //Last reference can be dropped by a writer, i.e., from another thread
+    zmq_msg_close(&(zmsg->msg));
+    md_slab_free_remote(zmsg->pool, zmsg);
+}
+
+static void md_input_zeromq_handle_msg(struct md_input_zeromq_worker *mzw,
+                                       struct md_input_zeromq_sock *sock,
+                                       struct md_input_zeromq_msg *zmsg)
+{
+    struct md_input_zeromq *miz = mzw->miz;
+    struct md_json_msg *msg = &(mzw->json_msg);
+    char *data = zmq_msg_data(&(zmsg->msg)), *payload;
+    size_t len = zmq_msg_size(&(zmsg->msg));
+    uint8_t event_type = 0;
+
+    //Skip topic. Topics are ASCII, so the payload starts at the first '{'
+    //(JSON) or byte with the high bit set (first byte of a MessagePack map)
+    for (payload = data; payload < data + len && *payload != '{' &&
+            !(*((uint8_t*) payload) & 0x80); payload++);
+
+    if (payload == data + len)
+        return;
+
+    len -= payload - data;
+
+    if (*payload == '{') {
+        //The message is modified by the parser, so log it first
+        META_PRINT(miz->parent->logfile, "Got JSON %.*s\n", (int) len, payload);
+
+        if (md_json_parse(msg, payload, len)) {
+            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Received invalid JSON object on ZMQ socket\n");
+            return;
         }
+    } else {
+        META_PRINT(miz->parent->logfile, "Got MessagePack message (%zu bytes)\n",
+                len);
 
-        if (!json_object_object_get_ex(zmqh_obj, "event_type", &json_event)) {
-            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Missing event type\n");
-            json_object_put(zmqh_obj);
-            zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
-            continue;
+        if (md_msgpack_parse(msg, payload, len)) {
+            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Received invalid MessagePack map on ZMQ socket\n");
+            return;
         }
+    }
+
+    //We are inserting the sequence number, so that we can see the order in
+    //which events arrived at the metadata exporter, making it easier to
+    //correlate events between applications. The different applications
+    //publishing data might also insert their own sequence number
+    md_json_set_int(msg, MD_JSON_KEY_MD_SEQ, mde_inc_seq(miz->parent));
+
+    if (!md_json_get(msg, MD_JSON_KEY_EVENT_TYPE)) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Missing event type\n");
+        return;
+    }
+
+    event_type = (uint8_t) md_json_get_int(msg, MD_JSON_KEY_EVENT_TYPE, 0);
+
+    //Only subscribed topics are delivered, this guards against publishers
+    //sending other event types on a topic
+    if (!(event_type & miz->md_zmq_mask))
+        return;
+
+    mzw->cur_msg = zmsg;
+    mzw->cur_origin = sock->origin;
+
+    switch (event_type) {
+        case META_TYPE_INTERFACE:
+            md_input_zeromq_handle_iface_event(mzw, msg);
+            break;
+        case META_TYPE_CONNECTION:
+            md_input_zeromq_handle_conn_event(mzw, msg);
+            break;
+        case META_TYPE_POS:
+            md_input_zeromq_handle_gps_event(mzw, msg);
+            break;
+        case META_TYPE_RADIO:
+            md_input_zeromq_handle_radio_event(mzw, msg);
+            break;
+        case META_TYPE_SYSTEM:
+            md_input_zeromq_handle_system_event(mzw, msg);
+            break;
+        default:
+            META_PRINT(miz->parent->logfile, "Unknown event type\n");
+            break;
+    }
+
+    mzw->cur_msg = NULL;
+}
 
-        event_type = (uint8_t) json_object_get_int(json_event);
+static void md_input_zeromq_handle_event(void *ptr, int32_t fd, uint32_t events)
+{
+    struct md_input_zeromq_sock *sock = ptr;
+    struct md_input_zeromq_worker *mzw = sock->worker;
+    struct md_input_zeromq_msg *zmsg;
+    int zmq_events = 0;
+    size_t events_len = sizeof(zmq_events);
+
+    md_input_budget_start(&(sock->budget));
+    zmq_getsockopt(sock->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
 
-        if (!(event_type & miz->md_zmq_mask)) {
-            json_object_put(zmqh_obj);
+    while (zmq_events & ZMQ_POLLIN)
+    {
+        if (md_input_budget_spent(&(sock->budget))) {
+            md_input_budget_yield(&(sock->budget), mzw->event_loop);
             return;
         }
 
-        json_str = json_object_to_json_string(zmqh_obj);
-        META_PRINT(miz->parent->logfile, "Got JSON %s\n", json_str);
-
-        switch (event_type) {
-            case META_TYPE_INTERFACE:
-                md_input_zeromq_handle_iface_event(miz, zmqh_obj);
-                break;
-            case META_TYPE_CONNECTION:
-                md_input_zeromq_handle_conn_event(miz, zmqh_obj);
-                break;
-            case META_TYPE_POS:
-                md_input_zeromq_handle_gps_event(miz, zmqh_obj);
-                break;
-            case META_TYPE_RADIO:
-                md_input_zeromq_handle_radio_event(miz, zmqh_obj);
-                break;
-            case META_TYPE_SYSTEM:
-                md_input_zeromq_handle_system_event(miz, zmqh_obj);
-                break;
-            default:
-                META_PRINT(miz->parent->logfile, "Unknown event type\n");
-                break;
+        //Message is received directly into a zmq_msg_t and parsed in place, so
+        //there is no copy and no limit on the message size. Events published
+        //from the message hold a reference, so it is released by whoever is
+        //done last of us and the writers
+        if (!(zmsg = md_slab_alloc(&(mzw->msg_pool)))) {
+            META_PRINT_SYSLOG(mzw->parent, LOG_ERR, "Failed to allocate ZMQ message\n");
+            //ZMQ_FD is edge-triggered and not reported again for the messages
+            //that are already queued, so retry on the next iteration
+            md_input_budget_yield(&(sock->budget), mzw->event_loop);
+            return;
         }
 
-        json_object_put(zmqh_obj);
-        zmq_getsockopt(miz->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
+        zmsg->pool = &(mzw->msg_pool);
+        zmsg->backing.refcnt = 1;
+        zmsg->backing.release = md_input_zeromq_msg_release;
+        zmq_msg_init(&(zmsg->msg));
+
+        if (zmq_msg_recv(&(zmsg->msg), sock->zmq_socket, 0) != -1)
+            md_input_zeromq_handle_msg(mzw, sock, zmsg);
+
+        md_event_backing_put(&(zmsg->backing));
+        zmq_getsockopt(sock->zmq_socket, ZMQ_EVENTS, &zmq_events, &events_len);
     }
 }
 
-static uint8_t md_input_zeromq_config(struct md_input_zeromq *miz)
+//Called from the budget task, when the handler yielded with messages left
+static void md_input_zeromq_resume(void *ptr)
 {
-    int zmq_fd = -1;
-    size_t len = 0;
+    struct md_input_zeromq_sock *sock = ptr;
 
-    // Create ZMQ publisher
-    miz->zmq_ctx = zmq_ctx_new();
-    if (miz->zmq_ctx == NULL) {
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't create ZMQ context\n");
-        return RETVAL_FAILURE;
+    md_input_zeromq_handle_event(sock, sock->zmq_fd, EPOLLIN);
+}
+
+//Busy poll callback, ZMQ_EVENTS also processes pending commands from the
+//ZeroMQ I/O thread, so new messages are seen without waiting for ZMQ_FD
+static uint8_t md_input_zeromq_poll(void *ptr)
+{
+    struct md_input_zeromq_worker *mzw = ptr;
+    struct md_input_zeromq_sock *sock;
+    int zmq_events = 0;
+    size_t events_len = sizeof(zmq_events);
+    uint8_t retval = 0;
+
+    for (sock = mzw->socks; sock != NULL; sock = sock->next) {
+        if (zmq_getsockopt(sock->zmq_socket, ZMQ_EVENTS, &zmq_events,
+                    &events_len) || !(zmq_events & ZMQ_POLLIN))
+            continue;
+
+        md_input_zeromq_handle_event(sock, sock->zmq_fd, EPOLLIN);
+        retval = 1;
     }
 
-    miz->zmq_socket = zmq_socket(miz->zmq_ctx, ZMQ_SUB);
-    if (miz->zmq_socket == NULL) {
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't create ZMQ socket\n");
-        return RETVAL_FAILURE;
+    return retval;
+}
+
+static void md_input_zeromq_log_slab(struct md_input_zeromq_worker *mzw,
+                                     const char *name, struct md_slab *slab,
+                                     uint64_t *last_grows)
+{
+    struct md_slab_stats *stats = &(slab->stats);
+
+    //Only interesting if the slab had to grow since last time
+    if (stats->grows == *last_grows)
+        return;
+
+    META_PRINT_SYSLOG(mzw->parent, LOG_INFO, "ZMQ input %s %s: allocs %"
+            PRIu64 " remote frees %" PRIu64 " grows %" PRIu64 " capacity %u "
+            "max in use %u\n", mzw->name, name, stats->allocs,
+            stats->remote_frees, stats->grows, stats->capacity,
+            stats->max_in_use);
+    *last_grows = stats->grows;
+}
+
+//Called from the loop of the worker
+static void md_input_zeromq_worker_log_stats(void *ptr)
+{
+    struct md_input_zeromq_worker *mzw = ptr;
+    struct md_input_zeromq_sock *sock;
+    uint64_t yields = 0, last_yields = 0;
+
+    for (sock = mzw->socks; sock != NULL; sock = sock->next) {
+        yields += sock->budget.yields;
+        last_yields += sock->budget.last_yields;
+        sock->budget.last_yields = sock->budget.yields;
     }
 
-    if (((miz->md_zmq_mask & META_TYPE_INTERFACE) ||
-        (miz->md_zmq_mask & META_TYPE_POS) ||
-        (miz->md_zmq_mask & META_TYPE_RADIO) ||
-	(miz->md_zmq_mask & META_TYPE_SYSTEM)) &&
-        zmq_connect(miz->zmq_socket, "ipc:///tmp/nl_pub") == -1)
-    {
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't connect to NL ZMQ publisher\n");
-        return RETVAL_FAILURE;
+    if (yields != last_yields)
+        META_PRINT_SYSLOG(mzw->parent, LOG_INFO, "ZMQ input %s yielded %"
+                PRIu64 " times (+%" PRIu64 ") due to budget\n", mzw->name,
+                yields, yields - last_yields);
+
+    md_input_zeromq_log_slab(mzw, "event slab", &(mzw->event_slab),
+            &(mzw->last_slab_grows));
+    md_input_zeromq_log_slab(mzw, "message pool", &(mzw->msg_pool),
+            &(mzw->last_msg_pool_grows));
+    md_input_zeromq_log_slab(mzw, "clone pool", &(mzw->clone_pool),
+            &(mzw->last_clone_pool_grows));
+}
+
+//Worker 0 runs on the loop of the input, the others get a loop (and thread) of
+//their own
+static uint8_t md_input_zeromq_worker_init(struct md_input_zeromq *miz,
+                                           uint8_t idx)
+{
+    struct md_input_zeromq_worker *mzw = &(miz->workers[idx]);
+
+    mzw->miz = miz;
+    mzw->parent = miz->parent;
+    mzw->log_stats = md_input_zeromq_worker_log_stats;
+
+    if (!idx) {
+        snprintf(mzw->name, sizeof(mzw->name), "zmq_input");
+        mzw->event_loop = miz->event_loop;
+    } else {
+        snprintf(mzw->name, sizeof(mzw->name), "zmq_input.%u", idx);
+
+        if (!(mzw->event_loop = mde_attach_input_loop(miz->parent, mzw->name,
+                        (struct md_input*) mzw)))
+            return RETVAL_FAILURE;
     }
 
-    if ((miz->md_zmq_mask & META_TYPE_CONNECTION) &&
-        zmq_connect(miz->zmq_socket, "ipc:///tmp/dlb_pub") == -1)
-    {
-        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't connect to DLB ZMQ publisher\n");
+    //TODO: guard with check for flag
+    mzw->mce = calloc(sizeof(struct md_conn_event), 1);
+    if (mzw->mce == NULL)
         return RETVAL_FAILURE;
-    }
 
-    if (miz->md_zmq_mask & META_TYPE_INTERFACE) {
-        subscribe_for_topic(ZMQ_NL_INTERFACE_TOPIC, miz);
-    }
+    mzw->mie = calloc(sizeof(struct md_iface_event), 1);
+    if (mzw->mie == NULL)
+        return RETVAL_FAILURE;
+
+    mzw->mre = calloc(sizeof(struct md_radio_event), 1);
+    if (mzw->mre == NULL)
+        return RETVAL_FAILURE;
+
+    mzw->mse = calloc(sizeof(md_system_event_t), 1);
+    if (mzw->mse == NULL)
+        return RETVAL_FAILURE;
 
-    if (miz->md_zmq_mask & META_TYPE_RADIO) {
-        subscribe_for_topic(ZMQ_NL_RADIOEVENT_TOPIC, miz);
+    //Radio and GPS events are parsed into objects from the slab. Events are
+    //copied when published, so only one object is in use at a time
+    if (md_slab_init(&(mzw->event_slab), sizeof(union md_nl_zmq_event),
+                MD_SLAB_DEFAULT_CHUNK) == RETVAL_FAILURE) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Failed to allocate event slab\n");
+        return RETVAL_FAILURE;
     }
 
-    if (miz->md_zmq_mask & META_TYPE_POS) {
-        subscribe_for_topic(ZMQ_NL_GPS_TOPIC, miz);
+    //Received messages and the events published to the writers are kept until
+    //the writers are done, so these pools grow to the number of messages in
+    //flight. After that, no memory is allocated per message
+    if (md_slab_init(&(mzw->msg_pool), sizeof(struct md_input_zeromq_msg),
+                MD_SLAB_DEFAULT_CHUNK) == RETVAL_FAILURE ||
+        md_slab_init(&(mzw->clone_pool), md_event_clone_max_size(),
+                MD_SLAB_DEFAULT_CHUNK) == RETVAL_FAILURE) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Failed to allocate ZMQ pools\n");
+        return RETVAL_FAILURE;
     }
 
-    if (miz->md_zmq_mask & META_TYPE_SYSTEM) {
-        subscribe_for_topic(ZMQ_NL_SYSTEMEVENT_TOPIC, miz);
+    if (miz->busy_poll_us && backend_event_loop_busy_poll(mzw->event_loop,
+                md_input_zeromq_poll, mzw, miz->busy_poll_us)) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Loop already has a busy poll "
+                "callback\n");
+        return RETVAL_FAILURE;
     }
 
-    if (miz->md_zmq_mask & META_TYPE_CONNECTION) {
-        subscribe_for_topic(ZMQ_DLB_METADATA_TOPIC, miz);
-        subscribe_for_topic(ZMQ_DLB_DATAUSAGE_TOPIC, miz);
+    return RETVAL_SUCCESS;
+}
+
+//Create socket and add it to the loop of mzw. The caller connects and
+//subscribes
+static uint8_t md_input_zeromq_sock_init(struct md_input_zeromq *miz,
+                                         struct md_input_zeromq_sock *sock,
+                                         struct md_input_zeromq_worker *mzw)
+{
+    int zmq_fd = -1;
+    size_t len = 0;
+
+    sock->worker = mzw;
+    sock->next = mzw->socks;
+    mzw->socks = sock;
+
+    md_input_budget_init(&(sock->budget), md_input_zeromq_resume, sock,
+            "zmq_input resume");
+    sock->budget.max_msgs = miz->budget.max_msgs;
+    sock->budget.max_us = miz->budget.max_us;
+
+    sock->zmq_socket = zmq_socket(miz->zmq_ctx, ZMQ_SUB);
+    if (sock->zmq_socket == NULL) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't create ZMQ socket\n");
+        return RETVAL_FAILURE;
     }
 
     len = sizeof(zmq_fd);
-    if (zmq_getsockopt(miz->zmq_socket, ZMQ_FD, &zmq_fd, &len) == -1) {
+    if (zmq_getsockopt(sock->zmq_socket, ZMQ_FD, &zmq_fd, &len) == -1) {
         META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't get ZMQ file descriptor\n");
         return RETVAL_FAILURE;
     }
 
-    if(!(miz->event_handle = backend_create_epoll_handle(miz,
+    sock->zmq_fd = zmq_fd;
+
+    if(!(sock->event_handle = backend_create_epoll_handle(sock,
                     zmq_fd, md_input_zeromq_handle_event)))
         return RETVAL_FAILURE;
 
-    backend_event_loop_update(miz->parent->event_loop, EPOLLIN, EPOLL_CTL_ADD,
-        zmq_fd, miz->event_handle);
+    sock->event_handle->name = sock->origin ? sock->origin : "zmq_input";
 
-    //TODO: guard with check for flag
-    miz->mce = calloc(sizeof(struct md_conn_event), 1);
-    if (miz->mce == NULL)
-        return RETVAL_FAILURE;
+    //ZMQ_FD only signals edges, the handler reads until ZMQ_POLLIN is cleared
+    backend_event_loop_update(mzw->event_loop, EPOLLIN | EPOLLET, EPOLL_CTL_ADD,
+        zmq_fd, sock->event_handle);
 
-    miz->mie = calloc(sizeof(struct md_iface_event), 1);
-    if (miz->mie == NULL)
-        return RETVAL_FAILURE;
+    return RETVAL_SUCCESS;
+}
+
+//Without nodes, one socket is connected to the local publishers. With nodes
+//(fan-in), every node gets a socket, so that we know where a message came from
+static uint8_t md_input_zeromq_config(struct md_input_zeromq *miz,
+                                      json_object *nodes)
+{
+    struct md_input_zeromq_sock *sock;
+    uint32_t i;
 
-    miz->mre = calloc(sizeof(struct md_radio_event), 1);
-    if (miz->mre == NULL)
+    // Create ZMQ publisher
+    miz->zmq_ctx = zmq_ctx_new();
+    if (miz->zmq_ctx == NULL) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Can't create ZMQ context\n");
         return RETVAL_FAILURE;
+    }
+
+    miz->num_socks = 1;
+
+    if (nodes != NULL) {
+        miz->num_socks = json_object_object_length(nodes);
+
+        if (!miz->num_socks) {
+            META_PRINT_SYSLOG(miz->parent, LOG_ERR, "No ZMQ nodes configured\n");
+            return RETVAL_FAILURE;
+        }
+    }
+
+    //No point in having idle threads
+    if (miz->num_workers > miz->num_socks)
+        miz->num_workers = miz->num_socks;
 
-    miz->mse = calloc(sizeof(md_system_event_t), 1);
-    if (miz->mre == NULL)
+    if (!(miz->socks = calloc(miz->num_socks,
+                    sizeof(struct md_input_zeromq_sock))))
         return RETVAL_FAILURE;
 
+    for (i = 0; i < miz->num_workers; i++) {
+        if (md_input_zeromq_worker_init(miz, i))
+            return RETVAL_FAILURE;
+    }
+
+    if (nodes == NULL) {
+        sock = &(miz->socks[0]);
+
+        return md_input_zeromq_sock_init(miz, sock, &(miz->workers[0])) ||
+               md_input_zeromq_connect_local(miz, sock) ||
+               md_input_zeromq_subscribe(miz, sock);
+    }
+
+    i = 0;
+
+    //Nodes are spread evenly over the workers, in the order they are listed.
+    //The config is released after init, so the name is copied
+    json_object_object_foreach(nodes, name, endpoints) {
+        sock = &(miz->socks[i]);
+
+        if (!(sock->origin = strdup(name)))
+            return RETVAL_FAILURE;
+
+        if (md_input_zeromq_sock_init(miz, sock,
+                    &(miz->workers[i % miz->num_workers])) ||
+            md_input_zeromq_connect_node(miz, sock, endpoints) ||
+            md_input_zeromq_subscribe(miz, sock))
+            return RETVAL_FAILURE;
+
+        i++;
+    }
+
     return RETVAL_SUCCESS;
 }
 
 static uint8_t md_input_zeromq_init(void *ptr, json_object* config)
 {
     struct md_input_zeromq *miz = ptr;
+    json_object *nodes = NULL;
+    int32_t workers;
     miz->md_zmq_mask = 0;
+    miz->num_workers = 1;
+
+    //Only holds the configured limits, every socket has its own budget
+    md_input_budget_init(&(miz->budget), NULL, NULL, NULL);
 
     json_object* subconfig;
     if (json_object_object_get_ex(config, "zmq_input", &subconfig)) {
         json_object_object_foreach(subconfig, key, val) {
-            if (!strcmp(key, "conn")) {
+            if (md_input_budget_config(&(miz->budget), key, val)) {
+                continue;
+            } else if (!strcmp(key, "busy_poll_us")) {
+                miz->busy_poll_us = (uint32_t) json_object_get_int(val);
+            } else if (!strcmp(key, "nodes")) {
+                if (!json_object_is_type(val, json_type_object)) {
+                    META_PRINT_SYSLOG(miz->parent, LOG_ERR, "ZMQ nodes must be an object\n");
+                    return RETVAL_FAILURE;
+                }
+
+                nodes = val;
+            } else if (!strcmp(key, "workers")) {
+                workers = json_object_get_int(val);
+
+                if (workers < 1 || workers > MD_INPUT_ZEROMQ_MAX_WORKERS) {
+                    META_PRINT_SYSLOG(miz->parent, LOG_ERR, "Number of ZMQ workers must be 1-%u\n",
+                            MD_INPUT_ZEROMQ_MAX_WORKERS);
+                    return RETVAL_FAILURE;
+                }
+
+                miz->num_workers = workers;
+            } else if (!strcmp(key, "conn")) {
                 miz->md_zmq_mask |= META_TYPE_CONNECTION;
 	    } else if (!strcmp(key, "pos")) {
                 miz->md_zmq_mask |= META_TYPE_POS;
@@ -441,7 +811,58 @@ static uint8_t md_input_zeromq_init(void *ptr, json_object* config)
         return RETVAL_FAILURE;
     }
 
-    return md_input_zeromq_config(miz);
+    //The SQLite and NNE writers keep one set of per-node state (primary keys,
+    //modem list), so events from different nodes would overwrite each other
+    if (nodes != NULL && (miz->parent->md_writers[MD_WRITER_SQLITE] ||
+                          miz->parent->md_writers[MD_WRITER_NNE])) {
+        META_PRINT_SYSLOG(miz->parent, LOG_ERR, "ZMQ nodes can't be combined "
+                "with the SQLite or NNE writer\n");
+        return RETVAL_FAILURE;
+    }
+
+    return md_input_zeromq_config(miz, nodes);
+}
+
+//Workers other than 0 log their stats from their own loop
+static void md_input_zeromq_log_stats(void *ptr)
+{
+    struct md_input_zeromq *miz = ptr;
+
+    md_input_zeromq_worker_log_stats(&(miz->workers[0]));
+}
+
+static void md_input_zeromq_destroy(void *ptr)
+{
+    struct md_input_zeromq *miz = ptr;
+    struct md_input_zeromq_worker *mzw;
+    uint8_t in_use = 0;
+    uint32_t i;
+
+    for (i = 0; i < miz->num_socks; i++) {
+        if (miz->socks[i].zmq_socket)
+            zmq_close(miz->socks[i].zmq_socket);
+    }
+
+    for (i = 0; i < miz->num_workers; i++) {
+        mzw = &(miz->workers[i]);
+        md_slab_destroy(&(mzw->event_slab));
+
+        //Writers might still hold messages/events, those pools are left alone
+        if (md_slab_in_use(&(mzw->msg_pool)) ||
+            md_slab_in_use(&(mzw->clone_pool))) {
+            META_PRINT_SYSLOG(miz->parent, LOG_INFO, "ZMQ input %s still has "
+                    "events in flight, not freeing pools\n", mzw->name);
+            in_use = 1;
+            continue;
+        }
+
+        md_slab_destroy(&(mzw->msg_pool));
+        md_slab_destroy(&(mzw->clone_pool));
+    }
+
+    //Terminating the context blocks until all messages are closed
+    if (!in_use && miz->zmq_ctx)
+        zmq_ctx_term(miz->zmq_ctx);
 }
 
 void md_zeromq_input_usage()
@@ -452,6 +873,15 @@ void md_zeromq_input_usage()
     fprintf(stderr, "  \"iface\":\t\tReceive ZeroMQ interface events\n");
     fprintf(stderr, "  \"radio\":\t\tReceive ZeroMQ radio events (QXDM + neigh. cells)\n");
     fprintf(stderr, "  \"system\":\t\tReceive ZeroMQ system events (modem restarts)\n");
+    md_input_budget_usage();
+    fprintf(stderr, "  \"busy_poll_us\":\tspin on socket for up to this long (us) before blocking.\n");
+    fprintf(stderr, "\t\t\tLowers latency at the cost of CPU (default: 0, always block)\n");
+    fprintf(stderr, "  \"nodes\":\t\tfan-in from remote nodes instead of the local publishers. Object\n");
+    fprintf(stderr, "\t\t\tmapping node name to endpoint (or array of endpoints), e.g.\n");
+    fprintf(stderr, "\t\t\t{\"node1\": \"tcp://10.0.0.1:5556\"}. Events are tagged with the node name\n");
+    fprintf(stderr, "\t\t\tNot supported together with the SQLite or NNE writer\n");
+    fprintf(stderr, "  \"workers\":\t\tnumber of threads the nodes are spread over (default: 1, max: %u)\n",
+            MD_INPUT_ZEROMQ_MAX_WORKERS);
     fprintf(stderr, "},\n");
 }
 
@@ -459,4 +889,6 @@ void md_zeromq_input_setup(struct md_exporter *mde, struct md_input_zeromq *miz)
 {
     miz->parent = mde;
     miz->init = md_input_zeromq_init;
+    miz->log_stats = md_input_zeromq_log_stats;
+    miz->destroy = md_input_zeromq_destroy;
 }
@@ -26,6 +26,13 @@
 
 #pragma once
 #include "metadata_exporter.h"
+#include "metadata_slab.h"
+#include "metadata_input_budget.h"
+#include "metadata_json_stream.h"
+
+#define ZMQ_NL_ENDPOINT "ipc:///tmp/nl_pub"
+
+#define ZMQ_DLB_ENDPOINT "ipc:///tmp/dlb_pub"
 
 #define ZMQ_NL_INTERFACE_TOPIC "CELERWAY.NL.INTERFACE"
 
@@ -39,19 +46,69 @@
 
 #define ZMQ_DLB_DATAUSAGE_TOPIC "CELERWAY.DLB.DATAUSAGE"
 
+//Worker 0 runs on the loop of the input, the rest on loops of their own
+#define MD_INPUT_ZEROMQ_MAX_WORKERS (MDE_MAX_INPUT_LOOPS + 1)
+
 struct backend_epoll_handle;
+struct md_input_zeromq_msg;
+struct md_input_zeromq;
+struct md_input_zeromq_worker;
 
-struct md_input_zeromq {
-    MD_INPUT;
+//One SUB socket. Without nodes in the config there is a single socket,
+//connected to the local publishers. In fan-in mode every node gets a socket,
+//since a socket does not tell which peer sent a message
+struct md_input_zeromq_sock {
+    struct md_input_zeromq_worker *worker;
     struct backend_epoll_handle *event_handle;
-    uint32_t md_zmq_mask;
-    void* zmq_ctx;
     void* zmq_socket;
     int zmq_fd;
+    //Name of node, NULL for the local publishers
+    char *origin;
+    struct md_input_budget budget;
+    //Next socket handled by the same worker
+    struct md_input_zeromq_sock *next;
+};
+
+//The sockets are partitioned over the workers, each running on its own loop
+//(and thread). Workers have their own parse state, so they share nothing but
+//the exporter. MD_INPUT must be first, workers are registered on their loops
+//like inputs
+struct md_input_zeromq_worker {
+    MD_INPUT;
+    struct md_input_zeromq *miz;
+    struct md_input_zeromq_sock *socks;
     struct md_conn_event *mce;
     struct md_iface_event *mie;
     struct md_radio_event *mre;
     md_system_event_t *mse;
+    struct md_slab event_slab;
+    //Received messages and events passed to the writers, released by the
+    //writers with md_slab_free_remote()
+    struct md_slab msg_pool;
+    struct md_slab clone_pool;
+    //Values of the message being parsed, events point into the message
+    struct md_json_msg json_msg;
+    struct md_input_zeromq_msg *cur_msg;
+    const char *cur_origin;
+    uint64_t last_slab_grows;
+    uint64_t last_msg_pool_grows;
+    uint64_t last_clone_pool_grows;
+    //Also used as name of the loop
+    char name[16];
+};
+
+struct md_input_zeromq {
+    MD_INPUT;
+    uint32_t md_zmq_mask;
+    void* zmq_ctx;
+    struct md_input_zeromq_sock *socks;
+    uint32_t num_socks;
+    struct md_input_zeromq_worker workers[MD_INPUT_ZEROMQ_MAX_WORKERS];
+    uint8_t num_workers;
+    //Configured limits, copied to the budget of every socket
+    struct md_input_budget budget;
+    //0 means busy polling is disabled
+    uint32_t busy_poll_us;
 };
 
 void md_zeromq_input_usage();
@@ -0,0 +1,148 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//Microbenchmark for the streaming JSON parser used by the ZeroMQ input. Built
+//when JSON_BENCH is set. Input is a capture of ZeroMQ messages, one message per
+//line, e.g., "CELERWAY.NL.INTERFACE {...}". Everything in front of the first {
+//is ignored, like in the input. Every message is parsed with json-c and with
+//every scanner supported by the CPU.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include JSON_LOC
+
+#include "metadata_exporter.h"
+#include "metadata_json_stream.h"
+#include "metadata_json_scan.h"
+
+#define JSON_BENCH_MAX_MSGS     100000
+#define JSON_BENCH_MSG_LEN      8192
+
+static uint64_t json_bench_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void json_bench_report(const char *name, uint64_t ns, uint32_t num_msgs,
+                              uint32_t iterations, uint64_t bytes)
+{
+    printf("%-10s %8.1f ns/msg %8.1f MB/s\n", name,
+            ((double) ns) / (num_msgs * (uint64_t) iterations),
+            ((double) bytes * iterations * 1000) / ns);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *scanners[] = {"scalar", "sse2", "avx2"};
+    static char line[JSON_BENCH_MSG_LEN];
+    static struct md_json_msg msg;
+    char **msgs, *buf, *json;
+    size_t *lens;
+    uint32_t num_msgs = 0, iterations, i, j, invalid = 0;
+    uint64_t bytes = 0, start;
+    json_object *obj;
+    size_t k;
+    FILE *fp;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <capture> [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    iterations = argc > 2 ? atoi(argv[2]) : 100;
+
+    if (!(fp = fopen(argv[1], "r"))) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    msgs = calloc(JSON_BENCH_MAX_MSGS, sizeof(char*));
+    lens = calloc(JSON_BENCH_MAX_MSGS, sizeof(size_t));
+    buf = malloc(JSON_BENCH_MSG_LEN);
+
+    if (msgs == NULL || lens == NULL || buf == NULL)
+        return EXIT_FAILURE;
+
+    while (num_msgs < JSON_BENCH_MAX_MSGS && fgets(line, sizeof(line), fp)) {
+        if (!(json = strchr(line, '{')))
+            continue;
+
+        lens[num_msgs] = strlen(json);
+        bytes += lens[num_msgs];
+        msgs[num_msgs++] = strdup(json);
+    }
+
+    fclose(fp);
+
+    if (!num_msgs) {
+        fprintf(stderr, "No messages in %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%u messages, %" PRIu64 " bytes, %u iterations\n", num_msgs, bytes,
+            iterations);
+
+    start = json_bench_ns();
+    for (i = 0; i < iterations; i++) {
+        for (j = 0; j < num_msgs; j++) {
+            if ((obj = json_tokener_parse(msgs[j])))
+                json_object_put(obj);
+        }
+    }
+    json_bench_report("json-c", json_bench_ns() - start, num_msgs, iterations,
+            bytes);
+
+    //The parser works in place, so the message is copied before every parse
+    for (k = 0; k < sizeof(scanners) / sizeof(scanners[0]); k++) {
+        if (md_json_scanner_set(scanners[k])) {
+            printf("%-10s not supported\n", scanners[k]);
+            continue;
+        }
+
+        start = json_bench_ns();
+        for (i = 0; i < iterations; i++) {
+            for (j = 0; j < num_msgs; j++) {
+                memcpy(buf, msgs[j], lens[j]);
+
+                if (md_json_parse(&msg, buf, lens[j]) && !i)
+                    invalid++;
+            }
+        }
+        json_bench_report(scanners[k], json_bench_ns() - start, num_msgs,
+                iterations, bytes);
+    }
+
+    if (invalid)
+        printf("%u messages were rejected by the parser\n", invalid);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//Generated by files/gen_json_keys.py from files/json_keys.txt, do not edit
+
+#include <string.h>
+
+#include "metadata_json_keys.h"
+
+static const char *md_json_key_names[MD_JSON_KEY_COUNT] = {
+    "md_seq",
+    "timestamp",
+    "event_type",
+    "event_param",
+    "iccid",
+    "imsi",
+    "imei",
+    "event_value",
+    "interface_id_type",
+    "interface_id",
+    "interface_name",
+    "interface_type",
+    "network_address_family",
+    "network_address",
+    "network_provider_type",
+    "network_provider",
+    "l3_session_id",
+    "l4_session_id",
+    "signal_strength",
+    "rx_bytes",
+    "tx_bytes",
+    "has_ip",
+    "connectivity",
+    "connection_mode",
+    "quality",
+    "ip_addr",
+    "internal_ip_addr",
+    "isp_name",
+    "ifname",
+    "imsi_mccmnc",
+    "network_mccmnc",
+    "cid",
+    "device_mode",
+    "device_sub_mode",
+    "rssi",
+    "ecio",
+    "rscp",
+    "lte_rssi",
+    "lte_rsrp",
+    "lte_rsrq",
+    "lac",
+    "lte_band",
+    "lte_freq",
+    "lte_pci",
+    "device_state",
+    "enodeb_id",
+    "ca_info",
+    "cell_id",
+    "plmn",
+    "arfcn",
+    "bsic",
+    "timing_advance",
+    "rx_lev",
+    "cell_geran_info_nmr",
+    "serving_bcch_arfcn",
+    "serving_pbcch_arfcn",
+    "serving_priority_class",
+    "serving_rxlev_avg",
+    "serving_c1",
+    "serving_c2",
+    "serving_c31",
+    "serving_c32",
+    "serving_five_second_timer",
+    "cell_reselect_status",
+    "recent_cell_selection",
+    "neighbor_cell_count",
+    "grr_cell_neighbor",
+    "cell_reselect_hysteresis",
+    "ms_txpwr_max_cch",
+    "rxlev_access_min",
+    "power_offset_valid",
+    "power_offset",
+    "neci",
+    "acs",
+    "opt_reselect_param_ind",
+    "cell_bar_qualify",
+    "cell_reselect_offset",
+    "temporary_offset",
+    "penalty_time",
+    "ciphering_state",
+    "ciphering_algorithm",
+    "num_ded_chans",
+    "dtx_indicator",
+    "power_level",
+    "starting_time_valid",
+    "starting_time",
+    "cipher_flag",
+    "cipher_algorithm",
+    "channel_mode_1",
+    "channel_mode_2",
+    "after_channel_config",
+    "before_channel_config",
+    "rrc_state",
+    "ul_uarfcn",
+    "dl_uarfcn",
+    "ura_id",
+    "cell_access_rest",
+    "call_accs",
+    "nmea_string",
+};
+
+static const uint8_t md_json_key_lens[MD_JSON_KEY_COUNT] = {
+    6, 9, 10, 11, 5, 4, 4, 11, 17, 12, 14, 14,
+    22, 15, 21, 16, 13, 13, 15, 8, 8, 6, 12, 15,
+    7, 7, 16, 8, 6, 11, 14, 3, 11, 15, 4, 4,
+    4, 8, 8, 8, 3, 8, 8, 7, 12, 9, 7, 7,
+    4, 5, 4, 14, 6, 19, 18, 19, 22, 17, 10, 10,
+    11, 11, 25, 20, 21, 19, 17, 24, 16, 16, 18, 12,
+    4, 3, 22, 16, 20, 16, 12, 15, 19, 13, 13, 11,
+    19, 13, 11, 16, 14, 14, 20, 21, 9, 9, 9, 6,
+    16, 9, 11,
+};
+
+//Hash slot to key id + 1, 0 is an empty slot
+static const uint8_t md_json_key_table[MD_JSON_KEY_TABLE_SIZE] = {
+    50, 0, 0, 0, 0, 0, 0, 6, 0, 0, 0, 0, 0, 95, 15, 0,
+    69, 0, 0, 0, 0, 0, 0, 0, 0, 0, 70, 0, 0, 0, 0, 0,
+    0, 79, 0, 0, 0, 0, 0, 0, 0, 31, 0, 0, 0, 2, 0, 0,
+    0, 0, 8, 0, 48, 0, 0, 0, 0, 82, 0, 0, 54, 0, 0, 0,
+    0, 0, 0, 19, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 56, 0, 21, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 62, 0, 0, 0, 0, 0, 0, 13, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 83, 0, 0, 0, 0, 47, 0, 0, 0,
+    0, 0, 0, 28, 0, 0, 78, 0, 0, 0, 0, 0, 0, 0, 0, 59,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 33, 97, 45, 0, 64, 0, 0,
+    41, 0, 25, 0, 22, 0, 0, 16, 0, 0, 11, 0, 0, 76, 0, 0,
+    0, 23, 86, 17, 0, 34, 0, 0, 0, 0, 75, 0, 0, 0, 0, 0,
+    30, 0, 0, 0, 0, 0, 60, 0, 0, 0, 0, 0, 0, 0, 0, 18,
+    0, 52, 0, 0, 0, 0, 0, 0, 0, 0, 0, 7, 0, 0, 0, 0,
+    57, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    77, 0, 0, 0, 98, 0, 0, 0, 0, 0, 0, 0, 0, 0, 61, 0,
+    24, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 58, 0, 0,
+    0, 5, 0, 0, 94, 0, 71, 0, 0, 0, 0, 0, 0, 38, 0, 0,
+    0, 0, 0, 96, 0, 74, 0, 0, 0, 72, 46, 0, 0, 0, 0, 0,
+    0, 0, 85, 3, 0, 0, 0, 87, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 37, 0, 66, 0, 88, 0, 92, 0, 39, 0, 67, 26, 0, 0, 0,
+    91, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 63, 27, 0,
+    0, 0, 0, 0, 0, 0, 0, 9, 0, 0, 0, 0, 0, 89, 0, 0,
+    44, 0, 0, 0, 10, 0, 99, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 93, 0, 0, 68, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 49, 81, 0, 0, 0, 84, 51, 4, 0, 0,
+    32, 0, 0, 0, 0, 0, 0, 0, 80, 0, 0, 0, 0, 0, 0, 43,
+    0, 0, 0, 0, 14, 0, 0, 12, 0, 0, 55, 0, 0, 0, 40, 0,
+    0, 0, 0, 29, 0, 0, 0, 0, 0, 0, 53, 0, 0, 0, 0, 0,
+    0, 35, 0, 0, 36, 0, 0, 0, 90, 0, 0, 73, 65, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 42, 0, 0, 0, 0, 0, 0, 0,
+};
+
+int16_t md_json_key_lookup(const char *key, size_t len)
+{
+    uint32_t h = MD_JSON_KEY_SEED;
+    uint8_t id;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        h = (h ^ (uint8_t) key[i]) * 16777619;
+
+    id = md_json_key_table[(h ^ (h >> 16)) & (MD_JSON_KEY_TABLE_SIZE - 1)];
+
+    if (!id-- || md_json_key_lens[id] != len ||
+        memcmp(md_json_key_names[id], key, len))
+        return -1;
+
+    return id;
+}
+
+const char* md_json_key_name(uint8_t id)
+{
+    return id < MD_JSON_KEY_COUNT ? md_json_key_names[id] : NULL;
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//Generated by files/gen_json_keys.py from files/json_keys.txt, do not edit
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MD_JSON_KEY_TABLE_SIZE  512
+#define MD_JSON_KEY_SEED        0x0000cc60
+
+enum md_json_key {
+    MD_JSON_KEY_MD_SEQ,
+    MD_JSON_KEY_TIMESTAMP,
+    MD_JSON_KEY_EVENT_TYPE,
+    MD_JSON_KEY_EVENT_PARAM,
+    MD_JSON_KEY_ICCID,
+    MD_JSON_KEY_IMSI,
+    MD_JSON_KEY_IMEI,
+    MD_JSON_KEY_EVENT_VALUE,
+    MD_JSON_KEY_INTERFACE_ID_TYPE,
+    MD_JSON_KEY_INTERFACE_ID,
+    MD_JSON_KEY_INTERFACE_NAME,
+    MD_JSON_KEY_INTERFACE_TYPE,
+    MD_JSON_KEY_NETWORK_ADDRESS_FAMILY,
+    MD_JSON_KEY_NETWORK_ADDRESS,
+    MD_JSON_KEY_NETWORK_PROVIDER_TYPE,
+    MD_JSON_KEY_NETWORK_PROVIDER,
+    MD_JSON_KEY_L3_SESSION_ID,
+    MD_JSON_KEY_L4_SESSION_ID,
+    MD_JSON_KEY_SIGNAL_STRENGTH,
+    MD_JSON_KEY_RX_BYTES,
+    MD_JSON_KEY_TX_BYTES,
+    MD_JSON_KEY_HAS_IP,
+    MD_JSON_KEY_CONNECTIVITY,
+    MD_JSON_KEY_CONNECTION_MODE,
+    MD_JSON_KEY_QUALITY,
+    MD_JSON_KEY_IP_ADDR,
+    MD_JSON_KEY_INTERNAL_IP_ADDR,
+    MD_JSON_KEY_ISP_NAME,
+    MD_JSON_KEY_IFNAME,
+    MD_JSON_KEY_IMSI_MCCMNC,
+    MD_JSON_KEY_NETWORK_MCCMNC,
+    MD_JSON_KEY_CID,
+    MD_JSON_KEY_DEVICE_MODE,
+    MD_JSON_KEY_DEVICE_SUB_MODE,
+    MD_JSON_KEY_RSSI,
+    MD_JSON_KEY_ECIO,
+    MD_JSON_KEY_RSCP,
+    MD_JSON_KEY_LTE_RSSI,
+    MD_JSON_KEY_LTE_RSRP,
+    MD_JSON_KEY_LTE_RSRQ,
+    MD_JSON_KEY_LAC,
+    MD_JSON_KEY_LTE_BAND,
+    MD_JSON_KEY_LTE_FREQ,
+    MD_JSON_KEY_LTE_PCI,
+    MD_JSON_KEY_DEVICE_STATE,
+    MD_JSON_KEY_ENODEB_ID,
+    MD_JSON_KEY_CA_INFO,
+    MD_JSON_KEY_CELL_ID,
+    MD_JSON_KEY_PLMN,
+    MD_JSON_KEY_ARFCN,
+    MD_JSON_KEY_BSIC,
+    MD_JSON_KEY_TIMING_ADVANCE,
+    MD_JSON_KEY_RX_LEV,
+    MD_JSON_KEY_CELL_GERAN_INFO_NMR,
+    MD_JSON_KEY_SERVING_BCCH_ARFCN,
+    MD_JSON_KEY_SERVING_PBCCH_ARFCN,
+    MD_JSON_KEY_SERVING_PRIORITY_CLASS,
+    MD_JSON_KEY_SERVING_RXLEV_AVG,
+    MD_JSON_KEY_SERVING_C1,
+    MD_JSON_KEY_SERVING_C2,
+    MD_JSON_KEY_SERVING_C31,
+    MD_JSON_KEY_SERVING_C32,
+    MD_JSON_KEY_SERVING_FIVE_SECOND_TIMER,
+    MD_JSON_KEY_CELL_RESELECT_STATUS,
+    MD_JSON_KEY_RECENT_CELL_SELECTION,
+    MD_JSON_KEY_NEIGHBOR_CELL_COUNT,
+    MD_JSON_KEY_GRR_CELL_NEIGHBOR,
+    MD_JSON_KEY_CELL_RESELECT_HYSTERESIS,
+    MD_JSON_KEY_MS_TXPWR_MAX_CCH,
+    MD_JSON_KEY_RXLEV_ACCESS_MIN,
+    MD_JSON_KEY_POWER_OFFSET_VALID,
+    MD_JSON_KEY_POWER_OFFSET,
+    MD_JSON_KEY_NECI,
+    MD_JSON_KEY_ACS,
+    MD_JSON_KEY_OPT_RESELECT_PARAM_IND,
+    MD_JSON_KEY_CELL_BAR_QUALIFY,
+    MD_JSON_KEY_CELL_RESELECT_OFFSET,
+    MD_JSON_KEY_TEMPORARY_OFFSET,
+    MD_JSON_KEY_PENALTY_TIME,
+    MD_JSON_KEY_CIPHERING_STATE,
+    MD_JSON_KEY_CIPHERING_ALGORITHM,
+    MD_JSON_KEY_NUM_DED_CHANS,
+    MD_JSON_KEY_DTX_INDICATOR,
+    MD_JSON_KEY_POWER_LEVEL,
+    MD_JSON_KEY_STARTING_TIME_VALID,
+    MD_JSON_KEY_STARTING_TIME,
+    MD_JSON_KEY_CIPHER_FLAG,
+    MD_JSON_KEY_CIPHER_ALGORITHM,
+    MD_JSON_KEY_CHANNEL_MODE_1,
+    MD_JSON_KEY_CHANNEL_MODE_2,
+    MD_JSON_KEY_AFTER_CHANNEL_CONFIG,
+    MD_JSON_KEY_BEFORE_CHANNEL_CONFIG,
+    MD_JSON_KEY_RRC_STATE,
+    MD_JSON_KEY_UL_UARFCN,
+    MD_JSON_KEY_DL_UARFCN,
+    MD_JSON_KEY_URA_ID,
+    MD_JSON_KEY_CELL_ACCESS_REST,
+    MD_JSON_KEY_CALL_ACCS,
+    MD_JSON_KEY_NMEA_STRING,
+    MD_JSON_KEY_COUNT
+};
+
+//Returns the id of key, or -1 if key is unknown. key does not have to be zero
+//terminated
+int16_t md_json_key_lookup(const char *key, size_t len);
+
+//Name of key with the given id
+const char* md_json_key_name(uint8_t id);
@@ -0,0 +1,230 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MD_JSON_SCAN_X86
+#endif
+
+#include "metadata_exporter.h"
+#include "metadata_json_scan.h"
+
+#define MD_JSON_CLASS_STRING    0x01
+#define MD_JSON_CLASS_NESTED    0x02
+
+static const uint8_t md_json_class[256] = {
+    ['\0'] = MD_JSON_CLASS_STRING | MD_JSON_CLASS_NESTED,
+    ['"'] = MD_JSON_CLASS_STRING | MD_JSON_CLASS_NESTED,
+    ['\\'] = MD_JSON_CLASS_STRING,
+    ['{'] = MD_JSON_CLASS_NESTED,
+    ['}'] = MD_JSON_CLASS_NESTED,
+    ['['] = MD_JSON_CLASS_NESTED,
+    [']'] = MD_JSON_CLASS_NESTED,
+};
+
+static const char* md_json_string_scalar(const char *p, const char *end)
+{
+    while (p < end && !(md_json_class[(uint8_t) *p] & MD_JSON_CLASS_STRING))
+        p++;
+
+    return p;
+}
+
+static const char* md_json_nested_scalar(const char *p, const char *end)
+{
+    while (p < end && !(md_json_class[(uint8_t) *p] & MD_JSON_CLASS_NESTED))
+        p++;
+
+    return p;
+}
+
+#ifdef MD_JSON_SCAN_X86
+//The vector versions use aligned loads. An aligned load never crosses a page
+//boundary, so as long as the block contains at least one byte of the buffer,
+//reading the rest of it can not fault. Bytes outside of [p, end) are ignored.
+//The loads are still out of bounds as far as ASan is concerned, so
+//instrumentation is disabled
+
+//i386 baselines do not always include SSE2, so it is enabled per function like
+//AVX2 and selected at runtime
+__attribute__((target("sse2")))
+static inline uint32_t md_json_string_mask_sse2(__m128i v)
+{
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return (uint32_t) _mm_movemask_epi8(m);
+}
+
+__attribute__((target("sse2")))
+static inline uint32_t md_json_nested_mask_sse2(__m128i v)
+{
+    //'[' and ']' differ from '{' and '}' only in bit 5
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                             _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')));
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return (uint32_t) _mm_movemask_epi8(m);
+}
+
+#define MD_JSON_SCAN_SSE2(fn, mask_fn) \
+__attribute__((target("sse2"), no_sanitize_address)) \
+static const char* fn(const char *p, const char *end) \
+{ \
+    uintptr_t offset = (uintptr_t) p & 15; \
+    const char *block = p - offset; \
+    uint32_t mask; \
+\
+    if (p >= end) \
+        return end; \
+\
+    mask = mask_fn(_mm_load_si128((const __m128i*) block)) & \
+        (0xFFFFU << offset); \
+\
+    while (!mask) { \
+        if ((block += 16) >= end) \
+            return end; \
+\
+        mask = mask_fn(_mm_load_si128((const __m128i*) block)); \
+    } \
+\
+    p = block + __builtin_ctz(mask); \
+    return p < end ? p : end; \
+}
+
+MD_JSON_SCAN_SSE2(md_json_string_sse2, md_json_string_mask_sse2)
+MD_JSON_SCAN_SSE2(md_json_nested_sse2, md_json_nested_mask_sse2)
+
+__attribute__((target("avx2")))
+static inline uint32_t md_json_string_mask_avx2(__m256i v)
+{
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return (uint32_t) _mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t md_json_nested_mask_avx2(__m256i v)
+{
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i m = _mm256_or_si256(
+            _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+            _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}')));
+
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return (uint32_t) _mm256_movemask_epi8(m);
+}
+
+#define MD_JSON_SCAN_AVX2(fn, mask_fn) \
+__attribute__((target("avx2"), no_sanitize_address)) \
+static const char* fn(const char *p, const char *end) \
+{ \
+    uintptr_t offset = (uintptr_t) p & 31; \
+    const char *block = p - offset; \
+    uint32_t mask; \
+\
+    if (p >= end) \
+        return end; \
+\
+    mask = mask_fn(_mm256_load_si256((const __m256i*) block)) & \
+        (0xFFFFFFFFU << offset); \
+\
+    while (!mask) { \
+        if ((block += 32) >= end) \
+            return end; \
+\
+        mask = mask_fn(_mm256_load_si256((const __m256i*) block)); \
+    } \
+\
+    p = block + __builtin_ctz(mask); \
+    return p < end ? p : end; \
+}
+
+MD_JSON_SCAN_AVX2(md_json_string_avx2, md_json_string_mask_avx2)
+MD_JSON_SCAN_AVX2(md_json_nested_avx2, md_json_nested_mask_avx2)
+#endif
+
+static const struct md_json_scanner md_json_scanners[] = {
+#ifdef MD_JSON_SCAN_X86
+    {"avx2", md_json_string_avx2, md_json_nested_avx2},
+    {"sse2", md_json_string_sse2, md_json_nested_sse2},
+#endif
+    {"scalar", md_json_string_scalar, md_json_nested_scalar},
+};
+
+#define MD_JSON_NUM_SCANNERS \
+    (sizeof(md_json_scanners) / sizeof(struct md_json_scanner))
+
+static const struct md_json_scanner *md_json_scanner = NULL;
+
+static uint8_t md_json_scanner_supported(const struct md_json_scanner *scanner)
+{
+#ifdef MD_JSON_SCAN_X86
+    if (!strcmp(scanner->name, "avx2"))
+        return __builtin_cpu_supports("avx2") != 0;
+    else if (!strcmp(scanner->name, "sse2"))
+        return __builtin_cpu_supports("sse2") != 0;
+#endif
+    return 1;
+}
+
+const struct md_json_scanner* md_json_scanner_get()
+{
+    size_t i;
+
+    //Scanners are sorted by preference and the last one is always supported.
+    //Every thread selects the same scanner, so racing here is harmless
+    if (md_json_scanner == NULL) {
+        for (i = 0; !md_json_scanner_supported(&md_json_scanners[i]); i++);
+        md_json_scanner = &md_json_scanners[i];
+    }
+
+    return md_json_scanner;
+}
+
+uint8_t md_json_scanner_set(const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < MD_JSON_NUM_SCANNERS; i++) {
+        if (!strcmp(md_json_scanners[i].name, name) &&
+            md_json_scanner_supported(&md_json_scanners[i])) {
+            md_json_scanner = &md_json_scanners[i];
+            return RETVAL_SUCCESS;
+        }
+    }
+
+    return RETVAL_FAILURE;
+}
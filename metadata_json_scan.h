@@ -0,0 +1,53 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+//Structural scanning used by the streaming JSON parser. The parser spends most
+//of its time looking for the end of strings and nested values, so these loops
+//are vectorized. On x86 an AVX2 or SSE2 version is picked at runtime, other
+//architectures use the scalar version.
+//
+//The scan functions return a pointer to the first matching character in
+//[p, end), or end if there is none. A zero byte always matches.
+
+struct md_json_scanner {
+    const char *name;
+    //Find first '"', '\\' or '\0'
+    const char* (*string)(const char *p, const char *end);
+    //Find first '"', '{', '}', '[', ']' or '\0'
+    const char* (*nested)(const char *p, const char *end);
+};
+
+//Scanner used by the parser. Selected on first use
+const struct md_json_scanner* md_json_scanner_get();
+
+//Use the scanner with the given name (scalar, sse2 or avx2) instead of the
+//one selected at runtime. Returns RETVAL_FAILURE if the scanner is not
+//supported by the build or the CPU. Mainly useful for benchmarking
+uint8_t md_json_scanner_set(const char *name);
@@ -0,0 +1,453 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "metadata_exporter.h"
+#include "metadata_json_stream.h"
+#include "metadata_json_scan.h"
+
+//Longer numbers are rejected
+#define MD_JSON_MAX_NUM_LEN     63
+
+//Parser state shared by the scan functions. end is one past the last byte of
+//the message, nothing at or after end is ever read or written
+struct md_json_parser {
+    const struct md_json_scanner *scanner;
+    char *end;
+};
+
+static inline char md_json_peek(const struct md_json_parser *ps, const char *p)
+{
+    return p < ps->end ? *p : '\0';
+}
+
+static inline char* md_json_skip_ws(const struct md_json_parser *ps, char *p)
+{
+    while (p < ps->end &&
+           (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+        p++;
+
+    return p;
+}
+
+static int32_t md_json_hex4(const struct md_json_parser *ps, const char *p)
+{
+    int32_t retval = 0;
+    uint8_t i;
+
+    if (ps->end - p < 4)
+        return -1;
+
+    for (i = 0; i < 4; i++) {
+        retval <<= 4;
+
+        if (p[i] >= '0' && p[i] <= '9')
+            retval |= p[i] - '0';
+        else if (p[i] >= 'a' && p[i] <= 'f')
+            retval |= p[i] - 'a' + 10;
+        else if (p[i] >= 'A' && p[i] <= 'F')
+            retval |= p[i] - 'A' + 10;
+        else
+            return -1;
+    }
+
+    return retval;
+}
+
+//Write code point as UTF-8, an escape sequence is always longer than the
+//encoded character so this is safe to do in place
+static char* md_json_put_utf8(char *out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *out++ = cp;
+    } else if (cp < 0x800) {
+        *out++ = 0xC0 | (cp >> 6);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        *out++ = 0xE0 | (cp >> 12);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    } else {
+        *out++ = 0xF0 | (cp >> 18);
+        *out++ = 0x80 | ((cp >> 12) & 0x3F);
+        *out++ = 0x80 | ((cp >> 6) & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+    }
+
+    return out;
+}
+
+//p points to the first character after the opening quote. Returns a pointer to
+//the character after the closing quote, or NULL if the string is invalid. If
+//unescape is set, the string is unescaped and zero terminated in place (the
+//terminator replaces the closing quote, or is written in front of it)
+static char* md_json_scan_string(const struct md_json_parser *ps, char *p,
+                                 uint8_t unescape)
+{
+    char *out = p, *special;
+    int32_t cp, low;
+
+    while (1) {
+        //Plain characters are skipped (and moved, if escapes have been removed)
+        //in one go
+        special = (char*) ps->scanner->string(p, ps->end);
+
+        if (unescape && out != p)
+            memmove(out, p, special - p);
+
+        out += special - p;
+        p = special;
+
+        switch (md_json_peek(ps, p)) {
+        case '"':
+            if (unescape)
+                *out = '\0';
+
+            return p + 1;
+        case '\\':
+            break;
+        default:
+            return NULL;
+        }
+
+        if (++p == ps->end)
+            return NULL;
+
+        if (!unescape) {
+            p++;
+            continue;
+        }
+
+        switch (*p) {
+        case '"':
+        case '\\':
+        case '/':
+            *out++ = *p;
+            break;
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case 'u':
+            if ((cp = md_json_hex4(ps, p + 1)) < 0)
+                return NULL;
+
+            p += 4;
+
+            //Surrogate pair
+            if (cp >= 0xD800 && cp < 0xDC00 && md_json_peek(ps, p + 1) == '\\' &&
+                md_json_peek(ps, p + 2) == 'u' &&
+                (low = md_json_hex4(ps, p + 3)) >= 0xDC00 && low < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                p += 6;
+            }
+
+            out = md_json_put_utf8(out, cp);
+            break;
+        default:
+            return NULL;
+        }
+
+        p++;
+    }
+}
+
+//Skip object or array. Brackets are only counted, not matched, the content of
+//nested values is never used for anything but copying
+static char* md_json_skip_nested(const struct md_json_parser *ps, char *p)
+{
+    uint32_t depth = 0;
+
+    do {
+        p = (char*) ps->scanner->nested(p, ps->end);
+
+        switch (md_json_peek(ps, p)) {
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            depth--;
+            break;
+        case '"':
+            if (!(p = md_json_scan_string(ps, p + 1, 0)))
+                return NULL;
+            continue;
+        default:
+            return NULL;
+        }
+
+        p++;
+    } while (depth);
+
+    return p;
+}
+
+static char* md_json_scan_literal(const struct md_json_parser *ps, char *p,
+                                  const char *literal)
+{
+    size_t len = strlen(literal);
+
+    if ((size_t) (ps->end - p) < len || memcmp(p, literal, len))
+        return NULL;
+
+    return p + len;
+}
+
+//The message is not zero terminated, so the number is copied before it is
+//converted
+static char* md_json_scan_number(const struct md_json_parser *ps, char *p,
+                                 int64_t *num)
+{
+    char buf[MD_JSON_MAX_NUM_LEN + 1], *end, *num_end;
+    size_t len;
+
+    for (end = p; end < ps->end && ((*end >= '0' && *end <= '9') ||
+                *end == '-' || *end == '+' || *end == '.' || *end == 'e' ||
+                *end == 'E'); end++);
+
+    if ((len = end - p) > MD_JSON_MAX_NUM_LEN)
+        return NULL;
+
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    *num = strtoll(buf, &num_end, 10);
+
+    //Like json-c, fractions are truncated when read as integer
+    if (*num_end == '.' || *num_end == 'e' || *num_end == 'E')
+        *num = md_json_double_to_int(strtod(buf, &num_end));
+
+    return num_end != buf ? p + (num_end - buf) : NULL;
+}
+
+//Scan the value starting at p and store it in val (NULL to skip the value).
+//Returns a pointer to the first character after the value, or NULL if the value
+//is invalid. Values other than strings are not zero terminated, that has to
+//wait until the caller has read the next delimiter
+static char* md_json_scan_value(const struct md_json_parser *ps, char *p,
+                                struct md_json_value *val)
+{
+    struct md_json_value tmp;
+
+    if (val == NULL)
+        val = &tmp;
+
+    val->str = p;
+    val->num = 0;
+
+    switch (md_json_peek(ps, p)) {
+    case '"':
+        val->type = MD_JSON_STRING;
+        val->str = p + 1;
+        return md_json_scan_string(ps, p + 1, val != &tmp);
+    case '{':
+    case '[':
+        val->type = MD_JSON_RAW;
+        return md_json_skip_nested(ps, p);
+    case 't':
+        val->type = MD_JSON_BOOL;
+        val->num = 1;
+        return md_json_scan_literal(ps, p, "true");
+    case 'f':
+        val->type = MD_JSON_BOOL;
+        return md_json_scan_literal(ps, p, "false");
+    case 'n':
+        val->type = MD_JSON_NULL;
+        val->str = NULL;
+        return md_json_scan_literal(ps, p, "null");
+    case '-':
+    case '0' ... '9':
+        val->type = MD_JSON_NUMBER;
+        return md_json_scan_number(ps, p, &(val->num));
+    default:
+        return NULL;
+    }
+}
+
+uint8_t md_json_parse(struct md_json_msg *msg, char *buf, size_t len)
+{
+    struct md_json_parser ps = {md_json_scanner_get(), buf + len};
+    struct md_json_value *val;
+    char *p, *key, *end;
+    int16_t id;
+    char delim;
+    uint32_t i;
+
+    //Values of earlier messages must not become valid again when gen wraps
+    if (++msg->gen == 0) {
+        for (i = 0; i < MD_JSON_KEY_COUNT; i++)
+            msg->values[i].gen = 0;
+
+        msg->gen = 1;
+    }
+
+    p = md_json_skip_ws(&ps, buf);
+
+    if (md_json_peek(&ps, p++) != '{')
+        return RETVAL_FAILURE;
+
+    p = md_json_skip_ws(&ps, p);
+
+    if (md_json_peek(&ps, p) == '}')
+        return RETVAL_SUCCESS;
+
+    while (1) {
+        if (md_json_peek(&ps, p++) != '"')
+            return RETVAL_FAILURE;
+
+        key = p;
+
+        if (!(p = md_json_scan_string(&ps, p, 0)))
+            return RETVAL_FAILURE;
+
+        id = md_json_key_lookup(key, p - key - 1);
+        p = md_json_skip_ws(&ps, p);
+
+        if (md_json_peek(&ps, p++) != ':')
+            return RETVAL_FAILURE;
+
+        val = id >= 0 ? &(msg->values[id]) : NULL;
+
+        if (!(end = md_json_scan_value(&ps, md_json_skip_ws(&ps, p), val)))
+            return RETVAL_FAILURE;
+
+        p = md_json_skip_ws(&ps, end);
+        delim = md_json_peek(&ps, p++);
+
+        if (delim != '}' && delim != ',')
+            return RETVAL_FAILURE;
+
+        //There is at least a delimiter after the value, so the terminator is
+        //written inside the message. Last occurrence of a key wins, same as
+        //json-c
+        if (val != NULL) {
+            if (val->type != MD_JSON_STRING)
+                *end = '\0';
+
+            val->gen = msg->gen;
+        }
+
+        if (delim == '}')
+            return RETVAL_SUCCESS;
+
+        p = md_json_skip_ws(&ps, p);
+    }
+}
+
+static int64_t md_json_value_int(const struct md_json_value *val)
+{
+    //json-c also parses strings when an integer is requested
+    if (val->type == MD_JSON_STRING)
+        return strtoll(val->str, NULL, 10);
+
+    return val->num;
+}
+
+int64_t md_json_get_int(const struct md_json_msg *msg, uint8_t key,
+                        int64_t def)
+{
+    const struct md_json_value *val = md_json_get(msg, key);
+
+    return val ? md_json_value_int(val) : def;
+}
+
+void md_json_set_int(struct md_json_msg *msg, uint8_t key, int64_t num)
+{
+    struct md_json_value *val = &(msg->values[key]);
+
+    val->type = MD_JSON_NUMBER;
+    val->str = NULL;
+    val->num = num;
+    val->gen = msg->gen;
+}
+
+int64_t md_json_double_to_int(double d)
+{
+    if (isnan(d))
+        return 0;
+
+    //INT64_MAX is rounded up to 2^63 when converted to double
+    if (d >= (double) INT64_MAX)
+        return INT64_MAX;
+    else if (d <= (double) INT64_MIN)
+        return INT64_MIN;
+
+    return (int64_t) d;
+}
+
+void md_json_fill(const struct md_json_msg *msg,
+                  const struct md_json_field *fields, size_t num_fields,
+                  void *event)
+{
+    const struct md_json_value *val;
+    uint8_t *dst;
+    int64_t num;
+    size_t i;
+
+    for (i = 0; i < num_fields; i++) {
+        if (!(val = md_json_get(msg, fields[i].key)))
+            continue;
+
+        dst = ((uint8_t*) event) + fields[i].offset;
+
+        if (fields[i].type == MD_JSON_FIELD_STR) {
+            *((const char**) dst) = val->str;
+            continue;
+        }
+
+        num = md_json_value_int(val);
+
+        switch (fields[i].type) {
+        case MD_JSON_FIELD_INT8:
+            *((uint8_t*) dst) = (uint8_t) num;
+            break;
+        case MD_JSON_FIELD_INT16:
+            *((uint16_t*) dst) = (uint16_t) num;
+            break;
+        case MD_JSON_FIELD_INT32:
+            *((uint32_t*) dst) = (uint32_t) num;
+            break;
+        case MD_JSON_FIELD_INT64:
+            *((uint64_t*) dst) = (uint64_t) num;
+            break;
+        }
+    }
+}
@@ -0,0 +1,119 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "metadata_json_keys.h"
+
+//Streaming parser for the flat JSON objects published to the ZeroMQ input.
+//Instead of building a json-c DOM, the message is scanned once and the value
+//of every known key (see files/json_keys.txt) is recorded in a table indexed
+//by key id. The input then fills the event structs from the table, see
+//md_json_fill().
+//
+//Nothing is allocated. The parser works in place, strings are unescaped and
+//zero terminated inside the message buffer, so the buffer must be writable and
+//outlive the event. The buffer does not have to be zero terminated. Nested objects and arrays are not parsed, the value is the
+//raw JSON text of the object/array. Values of unknown keys are only scanned far
+//enough to find where they end.
+
+enum md_json_type {
+    MD_JSON_NULL,
+    MD_JSON_NUMBER,
+    MD_JSON_BOOL,
+    MD_JSON_STRING,
+    //Object or array
+    MD_JSON_RAW,
+};
+
+struct md_json_value {
+    //Zero terminated text of value. Unescaped content for strings, JSON text
+    //for everything else. NULL for null
+    const char *str;
+    //Value of number/bool, strings are converted on access
+    int64_t num;
+    //Value is only valid when gen matches gen of message
+    uint32_t gen;
+    uint8_t type;
+};
+
+struct md_json_msg {
+    struct md_json_value values[MD_JSON_KEY_COUNT];
+    //Incremented for every message, so that the table does not have to be
+    //cleared
+    uint32_t gen;
+};
+
+//Type of the struct member written by md_json_fill(). Integers are truncated
+//to the size of the member, like the casts done on json_object_get_int*()
+enum md_json_field_type {
+    MD_JSON_FIELD_INT8,
+    MD_JSON_FIELD_INT16,
+    MD_JSON_FIELD_INT32,
+    MD_JSON_FIELD_INT64,
+    MD_JSON_FIELD_STR,
+};
+
+//Maps a key to a member of an event struct
+struct md_json_field {
+    uint8_t key;
+    uint8_t type;
+    uint16_t offset;
+};
+
+#define MD_JSON_FIELD(k, t, s, m) \
+    {MD_JSON_KEY_##k, MD_JSON_FIELD_##t, offsetof(s, m)}
+
+//Parse the JSON object in the first len bytes of buf. Returns RETVAL_FAILURE if
+//the message is not a valid object
+uint8_t md_json_parse(struct md_json_msg *msg, char *buf, size_t len);
+
+//Returns the value of key, or NULL if key was not present in the last message
+static inline const struct md_json_value* md_json_get(
+        const struct md_json_msg *msg, uint8_t key)
+{
+    return msg->values[key].gen == msg->gen ? &(msg->values[key]) : NULL;
+}
+
+//Value of key as integer, or def if key is missing
+int64_t md_json_get_int(const struct md_json_msg *msg, uint8_t key,
+                        int64_t def);
+
+//Overwrite (or add) an integer value, used for values inserted by the input
+void md_json_set_int(struct md_json_msg *msg, uint8_t key, int64_t num);
+
+//Truncate a double to integer. Like json-c, values out of range are clamped and
+//NaN gives 0, a plain cast is undefined for those
+int64_t md_json_double_to_int(double d);
+
+//Write every key in fields that is present in msg to the matching member of
+//event. Members of missing keys are not touched
+void md_json_fill(const struct md_json_msg *msg,
+                  const struct md_json_field *fields, size_t num_fields,
+                  void *event);
@@ -0,0 +1,280 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <string.h>
+
+#include "metadata_exporter.h"
+#include "metadata_msgpack.h"
+
+//Decoded header of a MessagePack object. For str/bin, data points to the
+//first byte of the content and len is the content length. For arrays and maps,
+//len is the number of objects that follow (two per map entry), for everything
+//else it is 0
+struct md_msgpack_obj {
+    uint8_t *hdr;
+    uint8_t *data;
+    uint64_t len;
+    int64_t num;
+    uint8_t type;
+};
+
+static inline uint64_t md_msgpack_be(const uint8_t *p, uint8_t size)
+{
+    uint64_t retval = 0;
+    uint8_t i;
+
+    for (i = 0; i < size; i++)
+        retval = (retval << 8) | p[i];
+
+    return retval;
+}
+
+static int64_t md_msgpack_float(const uint8_t *p, uint8_t size)
+{
+    uint64_t bits = md_msgpack_be(p, size);
+    uint32_t bits32;
+    double d;
+    float f;
+
+    if (size == 4) {
+        bits32 = (uint32_t) bits;
+        memcpy(&f, &bits32, sizeof(f));
+        d = f;
+    } else {
+        memcpy(&d, &bits, sizeof(d));
+    }
+
+    return md_json_double_to_int(d);
+}
+
+//Read the header of the object at p and fill obj. Returns a pointer to the
+//first byte after the header (or after the value for scalars, str and bin), or
+//NULL if the object does not fit in the buffer
+static uint8_t* md_msgpack_read(uint8_t *p, const uint8_t *end,
+                                struct md_msgpack_obj *obj)
+{
+    uint64_t ext_len;
+    uint8_t c, size = 0;
+
+    if (p >= end)
+        return NULL;
+
+    obj->hdr = p;
+    obj->len = 0;
+    obj->num = 0;
+    c = *p++;
+
+    if (c <= 0x7f || c >= 0xe0) {
+        obj->type = MD_JSON_NUMBER;
+        obj->num = (int8_t) c;
+        return p;
+    } else if (c <= 0x8f) {
+        obj->type = MD_JSON_RAW;
+        obj->len = (c & 0x0f) * 2;
+        return p;
+    } else if (c <= 0x9f) {
+        obj->type = MD_JSON_RAW;
+        obj->len = c & 0x0f;
+        return p;
+    } else if (c <= 0xbf) {
+        obj->type = MD_JSON_STRING;
+        obj->len = c & 0x1f;
+        obj->data = p;
+        return (uint64_t) (end - p) >= obj->len ? p + obj->len : NULL;
+    }
+
+    //Size of length/value following the type byte
+    switch (c) {
+    case 0xc0:
+    case 0xc2:
+    case 0xc3:
+        break;
+    case 0xcc: case 0xd0: case 0xc4: case 0xd9: case 0xd4: case 0xc7:
+        size = 1;
+        break;
+    case 0xcd: case 0xd1: case 0xc5: case 0xda: case 0xdc: case 0xde:
+    case 0xd5: case 0xc8:
+        size = 2;
+        break;
+    case 0xce: case 0xd2: case 0xca: case 0xc6: case 0xdb: case 0xdd:
+    case 0xdf: case 0xc9:
+        size = 4;
+        break;
+    case 0xcf: case 0xd3: case 0xcb:
+        size = 8;
+        break;
+    case 0xd6:
+        size = 4;
+        break;
+    case 0xd7:
+        size = 8;
+        break;
+    case 0xd8:
+        size = 16;
+        break;
+    default:
+        return NULL;
+    }
+
+    //fixext has no length, the type byte is part of the value. ext values are
+    //skipped by read, so len is 0
+    if (c >= 0xd4 && c <= 0xd8) {
+        obj->type = MD_JSON_RAW;
+        return (end - p) > size ? p + size + 1 : NULL;
+    }
+
+    if (end - p < size)
+        return NULL;
+
+    switch (c) {
+    case 0xc0:
+        obj->type = MD_JSON_NULL;
+        return p;
+    case 0xc2:
+    case 0xc3:
+        obj->type = MD_JSON_BOOL;
+        obj->num = c == 0xc3;
+        return p;
+    case 0xcc ... 0xcf:
+        obj->type = MD_JSON_NUMBER;
+        obj->num = (int64_t) md_msgpack_be(p, size);
+        return p + size;
+    case 0xd0 ... 0xd3:
+        obj->type = MD_JSON_NUMBER;
+        //Sign extend from the size of the value
+        obj->num = (int64_t) (md_msgpack_be(p, size) << (64 - size * 8)) >>
+            (64 - size * 8);
+        return p + size;
+    case 0xca:
+    case 0xcb:
+        obj->type = MD_JSON_NUMBER;
+        obj->num = md_msgpack_float(p, size);
+        return p + size;
+    case 0xc4 ... 0xc6:
+    case 0xd9 ... 0xdb:
+        obj->type = MD_JSON_STRING;
+        obj->len = md_msgpack_be(p, size);
+        obj->data = p + size;
+        return (uint64_t) (end - obj->data) >= obj->len ?
+            obj->data + obj->len : NULL;
+    case 0xdc:
+    case 0xdd:
+        obj->type = MD_JSON_RAW;
+        obj->len = md_msgpack_be(p, size);
+        return p + size;
+    case 0xde:
+    case 0xdf:
+        obj->type = MD_JSON_RAW;
+        obj->len = md_msgpack_be(p, size) * 2;
+        return p + size;
+    default:
+        //ext, type byte follows the length
+        obj->type = MD_JSON_RAW;
+        ext_len = md_msgpack_be(p, size) + 1;
+        return (uint64_t) (end - p - size) >= ext_len ?
+            p + size + ext_len : NULL;
+    }
+}
+
+//Skip the objects contained in an array/map. Every object is at least one
+//byte, so a bogus length ends at the end of the buffer
+static uint8_t* md_msgpack_skip(uint8_t *p, const uint8_t *end,
+                                uint64_t remaining)
+{
+    struct md_msgpack_obj obj;
+
+    while (remaining--) {
+        if (!(p = md_msgpack_read(p, end, &obj)))
+            return NULL;
+
+        //Scalars, strings and ext are already skipped by read
+        if (obj.type == MD_JSON_RAW) {
+            if (obj.len > (uint64_t) (end - p))
+                return NULL;
+
+            remaining += obj.len;
+        }
+    }
+
+    return p;
+}
+
+uint8_t md_msgpack_parse(struct md_json_msg *msg, char *buf, size_t len)
+{
+    const uint8_t *end = (uint8_t*) buf + len;
+    struct md_msgpack_obj map, key, obj;
+    struct md_json_value *val;
+    uint8_t *p;
+    uint64_t i;
+    int16_t id;
+
+    //Values of earlier messages must not become valid again when gen wraps
+    if (++msg->gen == 0) {
+        for (i = 0; i < MD_JSON_KEY_COUNT; i++)
+            msg->values[i].gen = 0;
+
+        msg->gen = 1;
+    }
+
+    if (!len || !md_msgpack_is_map(*((uint8_t*) buf)) ||
+        !(p = md_msgpack_read((uint8_t*) buf, end, &map)))
+        return RETVAL_FAILURE;
+
+    for (i = 0; i < map.len / 2; i++) {
+        if (!(p = md_msgpack_read(p, end, &key)) ||
+            key.type != MD_JSON_STRING ||
+            !(p = md_msgpack_read(p, end, &obj)))
+            return RETVAL_FAILURE;
+
+        //Nested arrays/maps are not stored
+        if (obj.type == MD_JSON_RAW) {
+            if (!(p = md_msgpack_skip(p, end, obj.len)))
+                return RETVAL_FAILURE;
+
+            continue;
+        }
+
+        if ((id = md_json_key_lookup((const char*) key.data, key.len)) < 0)
+            continue;
+
+        //Last occurrence of a key wins, same as for JSON
+        val = &(msg->values[id]);
+        val->type = obj.type;
+        val->num = obj.num;
+        val->str = NULL;
+        val->gen = msg->gen;
+
+        if (obj.type == MD_JSON_STRING) {
+            //Header is at least one byte, so there is room for the terminator
+            memmove(obj.hdr, obj.data, obj.len);
+            obj.hdr[obj.len] = '\0';
+            val->str = (const char*) obj.hdr;
+        }
+    }
+
+    return RETVAL_SUCCESS;
+}
@@ -0,0 +1,58 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "metadata_json_stream.h"
+
+//Decoder for MessagePack encoded ZeroMQ messages. The message must be a map,
+//and the values are stored in the same key table as for JSON messages, so the
+//events are filled by the same code (see md_json_fill()).
+//
+//Like the JSON parser, the decoder works in place. A string is moved one byte
+//towards the front, over its header, and zero terminated. The buffer must thus
+//be writable and outlive the event. Types are mapped as follows:
+//
+//* nil, bool, integers and strings map to the JSON types. bin is treated as
+//  a string.
+//* Floats are truncated when read as integers, like JSON numbers.
+//* Numbers have no text, so members filled as strings must be sent as strings.
+//* Nested arrays and maps are skipped. Values exported as raw JSON (e.g., the
+//  GRR neighbor list) must be sent as strings containing the JSON text.
+
+//Returns 1 if c is the first byte of a MessagePack map
+static inline uint8_t md_msgpack_is_map(uint8_t c)
+{
+    return (c >= 0x80 && c <= 0x8f) || c == 0xde || c == 0xdf;
+}
+
+//Decode the MessagePack map in the first len bytes of buf. Returns
+//RETVAL_FAILURE if the message is not a valid map
+uint8_t md_msgpack_parse(struct md_json_msg *msg, char *buf, size_t len);
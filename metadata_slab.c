@@ -0,0 +1,158 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "metadata_exporter.h"
+#include "metadata_slab.h"
+
+struct md_slab_chunk {
+    struct md_slab_chunk *next;
+    uint64_t objs[];
+};
+
+static uint8_t md_slab_grow(struct md_slab *slab)
+{
+    struct md_slab_chunk *chunk;
+    uint8_t *obj;
+    uint32_t i;
+
+    chunk = malloc(sizeof(struct md_slab_chunk) +
+            (slab->obj_size * slab->objs_per_chunk));
+
+    if (chunk == NULL)
+        return RETVAL_FAILURE;
+
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    //Link all objects in the new chunk into the free list
+    obj = (uint8_t*) chunk->objs;
+    for (i = 0; i < slab->objs_per_chunk; i++, obj += slab->obj_size) {
+        *((void**) obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    slab->stats.capacity += slab->objs_per_chunk;
+    slab->stats.grows++;
+
+    return RETVAL_SUCCESS;
+}
+
+uint8_t md_slab_init(struct md_slab *slab, size_t obj_size,
+                     uint32_t objs_per_chunk)
+{
+    memset(slab, 0, sizeof(struct md_slab));
+
+    //Keep objects 8 byte aligned, this also makes room for the free list link
+    slab->obj_size = (obj_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    slab->objs_per_chunk = objs_per_chunk ? objs_per_chunk :
+        MD_SLAB_DEFAULT_CHUNK;
+
+    return md_slab_grow(slab);
+}
+
+void md_slab_destroy(struct md_slab *slab)
+{
+    struct md_slab_chunk *chunk;
+
+    while ((chunk = slab->chunks) != NULL) {
+        slab->chunks = chunk->next;
+        free(chunk);
+    }
+
+    slab->free_list = NULL;
+    slab->remote_free = NULL;
+}
+
+//Move objects freed by other threads to the free list. The whole list is taken
+//at once, so there is no ABA problem with the concurrent pushes
+static void md_slab_reclaim(struct md_slab *slab)
+{
+    void *obj = __sync_lock_test_and_set(&(slab->remote_free), NULL), *next;
+
+    for (; obj != NULL; obj = next) {
+        next = *((void**) obj);
+        *((void**) obj) = slab->free_list;
+        slab->free_list = obj;
+    }
+}
+
+uint32_t md_slab_in_use(struct md_slab *slab)
+{
+    return slab->stats.allocs - slab->stats.frees -
+        __sync_add_and_fetch(&(slab->stats.remote_frees), 0);
+}
+
+void* md_slab_alloc(struct md_slab *slab)
+{
+    void *obj;
+
+    if (slab->free_list == NULL)
+        md_slab_reclaim(slab);
+
+    if (slab->free_list == NULL && md_slab_grow(slab) == RETVAL_FAILURE)
+        return NULL;
+
+    obj = slab->free_list;
+    slab->free_list = *((void**) obj);
+
+    slab->stats.allocs++;
+    slab->stats.in_use = md_slab_in_use(slab);
+    if (slab->stats.in_use > slab->stats.max_in_use)
+        slab->stats.max_in_use = slab->stats.in_use;
+
+    memset(obj, 0, slab->obj_size);
+    return obj;
+}
+
+void md_slab_free(struct md_slab *slab, void *obj)
+{
+    if (obj == NULL)
+        return;
+
+    *((void**) obj) = slab->free_list;
+    slab->free_list = obj;
+
+    slab->stats.frees++;
+    slab->stats.in_use--;
+}
+
+void md_slab_free_remote(struct md_slab *slab, void *obj)
+{
+    void *head;
+
+    if (obj == NULL)
+        return;
+
+    do {
+        head = __atomic_load_n(&(slab->remote_free), __ATOMIC_RELAXED);
+        *((void**) obj) = head;
+    } while (!__sync_bool_compare_and_swap(&(slab->remote_free), head, obj));
+
+    __sync_add_and_fetch(&(slab->stats.remote_frees), 1);
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Number of objects allocated every time a slab runs out of free objects
+#define MD_SLAB_DEFAULT_CHUNK   16
+
+struct md_slab_chunk;
+
+struct md_slab_stats {
+    //Number of calls to md_slab_alloc()/md_slab_free()
+    uint64_t allocs;
+    uint64_t frees;
+    //Number of calls to md_slab_free_remote(), updated atomically
+    uint64_t remote_frees;
+    //Number of times the slab had to go to the heap for a new chunk
+    uint64_t grows;
+    uint32_t in_use;
+    uint32_t max_in_use;
+    uint32_t capacity;
+};
+
+//Simple fixed-size object cache. Free objects are kept in a singly linked
+//list (the link is stored in the object itself), so that alloc and free are
+//O(1). Memory is only returned to the heap when the slab is destroyed, so once
+//the slab has grown to the number of objects in flight no more heap
+//allocations are done.
+//
+//A slab is not thread safe, each input owns its own slab. The only exception
+//is md_slab_free_remote(), which can be called from any thread. Objects freed
+//that way are pushed to a separate list, which the owner takes over when the
+//free list is empty
+struct md_slab {
+    struct md_slab_chunk *chunks;
+    void *free_list;
+    void *remote_free;
+    size_t obj_size;
+    uint32_t objs_per_chunk;
+    struct md_slab_stats stats;
+};
+
+//obj_size is rounded up to the size of a pointer. One chunk is allocated up
+//front
+uint8_t md_slab_init(struct md_slab *slab, size_t obj_size,
+                     uint32_t objs_per_chunk);
+void md_slab_destroy(struct md_slab *slab);
+
+//Returns a zeroed object, or NULL if a new chunk could not be allocated
+void* md_slab_alloc(struct md_slab *slab);
+void md_slab_free(struct md_slab *slab, void *obj);
+
+//Return an object from any thread, e.g., a writer releasing an event
+void md_slab_free_remote(struct md_slab *slab, void *obj);
+
+//Number of objects that have not been freed yet. A slab must not be destroyed
+//while objects are in use
+uint32_t md_slab_in_use(struct md_slab *slab);
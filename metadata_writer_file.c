@@ -31,6 +31,7 @@
 #include "backend_event_loop.h"
 #include "metadata_exporter_log.h"
 #include "metadata_exporter.h"
+#include "metadata_event.h"
 #include "metadata_writer_file.h"
 
 static int md_file_add_json_int(struct json_object *obj,
@@ -137,6 +138,8 @@ static void md_file_handle_iface_event(struct md_writer_file *mwf,
         md_file_add_json_int(obj, "event_type", mie->md_type) ||
         md_file_add_json_int(obj, "event_param", mie->event_param) ||
         md_file_add_json_int(obj, "sequence", mie->sequence) ||
+        md_file_add_json_string(obj, "origin",
+            md_event_get_origin((struct md_event*) mie)) ||
         md_file_add_json_string(obj, "iccid", mie->iccid) ||
         md_file_add_json_string(obj, "imsi", mie->imsi) ||
         md_file_add_json_string(obj, "imei", mie->imei) ||
@@ -203,6 +206,8 @@ static void md_file_handle_gps_event(struct md_writer_file *mwf,
     if (md_file_add_json_int(obj, "timestamp", mge->tstamp) ||
         md_file_add_json_int(obj, "event_type", mge->md_type) ||
         md_file_add_json_int(obj, "sequence", mge->sequence) ||
+        md_file_add_json_string(obj, "origin",
+            md_event_get_origin((struct md_event*) mge)) ||
         md_file_add_json_int(obj, "tstamp_tv.tv_sec", mge->tstamp_tv.tv_sec) ||
         md_file_add_json_int(obj, "tstamp_tv.tv_usec", mge->tstamp_tv.tv_usec) ||
         md_file_add_json_string(obj, "nmea_raw", mge->nmea_raw) ||
@@ -269,8 +274,14 @@ static int32_t md_file_init(void *ptr, json_object* config)
     if (gps_prefix) {
         memcpy(mwf->gps_prefix, gps_prefix, strlen(gps_prefix));
         mwf->gps_prefix_len = strlen(gps_prefix);
+        mde_writer_subscribe((struct md_writer*) mwf, META_TYPE_POS,
+                MD_EVENT_PARAM_ALL);
     }
 
+    if (modem_prefix)
+        mde_writer_subscribe((struct md_writer*) mwf, META_TYPE_INTERFACE,
+                MD_EVENT_PARAM_ALL);
+
     return RETVAL_SUCCESS;
 }
 
@@ -281,14 +292,10 @@ static void md_file_handle(struct md_writer *writer, struct md_event *event)
 
     switch (event->md_type) {
     case META_TYPE_INTERFACE:
-        if (mwf->modem_prefix[0]) {
-            md_file_handle_iface_event(mwf, (struct md_iface_event*) event);
-        }
+        md_file_handle_iface_event(mwf, (struct md_iface_event*) event);
         break;
     case META_TYPE_POS:
-        if (mwf->gps_prefix[0]) {
-            md_file_handle_gps_event(mwf, (struct md_gps_event*) event);
-        }
+        md_file_handle_gps_event(mwf, (struct md_gps_event*) event);
         break;
     default:
         return;
@@ -369,114 +369,239 @@ static uint8_t md_inventory_handle_insert_conn_event(struct md_writer_sqlite *mw
     return RETVAL_SUCCESS;
 }
 
-static int16_t md_inventory_get_last_update(struct md_writer_sqlite *mws,
-                                         struct md_conn_event *mce,
-                                         int16_t *mode, int16_t *quality)
+//Key is the values of the UPDATE_UPDATE key columns, in the order of
+//SELECT_LAST_UPDATES. Returns length of key, or -1 if key does not fit
+static int32_t md_inventory_update_key(char *key, uint32_t l3_session_id,
+                                       uint32_t l4_session_id,
+                                       const char *interface_id,
+                                       const char *iccid, const char *imsi,
+                                       uint8_t family, const char *address)
+{
+    int32_t len = snprintf(key, LAST_UPDATE_KEY_LEN, "%u,%u,%s,%s,%s,%u,%s",
+            l3_session_id, l4_session_id, interface_id, iccid, imsi, family,
+            address);
+
+    if (len < 0 || len >= LAST_UPDATE_KEY_LEN)
+        return -1;
+
+    return len;
+}
+
+static int32_t md_inventory_update_key_mce(struct md_writer_sqlite *mws,
+                                           struct md_conn_event *mce,
+                                           char *key)
 {
-    int16_t retval = -1;
-    int numbytes = 0;
     const char *no_iccid_str = "0";
-    const unsigned char *event_value_str = NULL;
-    char event_str_cpy[EVENT_STR_LEN];
-    sqlite3_stmt *stmt = mws->last_update;
-    sqlite3_clear_bindings(stmt);
-    sqlite3_reset(stmt);
 
-    *mode = -1;
-    *quality = -1;
+    //Same values as are bound in md_inventory_execute_insert_update()
+    if (mws->api_version == 2 && mce->interface_type == INTERFACE_MODEM)
+        return md_inventory_update_key(key, mce->l3_session_id,
+                mce->l4_session_id, mce->imei, mce->interface_id, mce->imsi,
+                mce->network_address_family, mce->network_address);
+    else
+        return md_inventory_update_key(key, mce->l3_session_id,
+                mce->l4_session_id, mce->interface_id, no_iccid_str,
+                no_iccid_str, mce->network_address_family,
+                mce->network_address);
+}
+
+//FNV-1a
+static uint32_t md_inventory_update_hash(const char *key, int32_t len)
+{
+    uint32_t h = 2166136261U;
+    int32_t i;
 
-    if (sqlite3_bind_int(stmt, 1, mce->l3_session_id) ||
-        sqlite3_bind_int(stmt, 2, mce->l4_session_id) ||
-        sqlite3_bind_int(stmt, 6, mce->network_address_family) ||
-        sqlite3_bind_text(stmt, 7, mce->network_address, strlen(mce->network_address), SQLITE_STATIC)) {
-        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to bind values to SELECT query\n");
-        return retval;
+    for (i = 0; i < len; i++)
+        h = (h ^ (uint8_t) key[i]) * 16777619;
+
+    return h;
+}
+
+static struct md_inventory_update* md_inventory_update_lookup(
+        struct md_writer_sqlite *mws, const char *key, uint32_t hash)
+{
+    struct md_inventory_update *update;
+
+    for (update = mws->last_updates[hash % LAST_UPDATE_BUCKETS]; update;
+            update = update->next) {
+        if (update->hash == hash && !strcmp(update->key, key))
+            return update;
     }
 
-    if (mws->api_version == 2 && mce->interface_type == INTERFACE_MODEM) {
-        if (sqlite3_bind_text(stmt, 4, mce->interface_id /*SimCardIccid*/, strlen(mce->interface_id), SQLITE_STATIC) ||
-            sqlite3_bind_text(stmt, 5, mce->imsi, strlen(mce->imsi), SQLITE_STATIC) ||
-            sqlite3_bind_text(stmt, 3, mce->imei /*InterfaceId*/, strlen(mce->imei), SQLITE_STATIC)) {
-            META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to bind IMEI\n");
-            return SQLITE_ERROR;
-        }
-    } else {
-        if (sqlite3_bind_text(stmt, 4, no_iccid_str /*SimCardIccid*/, strlen(no_iccid_str), SQLITE_STATIC) ||
-            sqlite3_bind_text(stmt, 5, no_iccid_str /*SimCardImsi*/, strlen(no_iccid_str), SQLITE_STATIC) ||
-            sqlite3_bind_text(stmt, 3, mce->interface_id, strlen(mce->interface_id), SQLITE_STATIC)) {
-            META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to bind interface id\n");
-            return SQLITE_ERROR;
+    return NULL;
+}
+
+static void md_inventory_update_store(struct md_writer_sqlite *mws,
+                                      const char *key, int32_t len,
+                                      int64_t tstamp, int16_t mode,
+                                      int16_t quality)
+{
+    uint32_t hash = md_inventory_update_hash(key, len);
+    struct md_inventory_update *update = md_inventory_update_lookup(mws, key,
+            hash);
+
+    if (!update) {
+        if (!(update = malloc(sizeof(struct md_inventory_update) + len + 1))) {
+            META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to allocate last "
+                    "update\n");
+            return;
         }
+
+        update->hash = hash;
+        memcpy(update->key, key, len + 1);
+        update->next = mws->last_updates[hash % LAST_UPDATE_BUCKETS];
+        mws->last_updates[hash % LAST_UPDATE_BUCKETS] = update;
     }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        event_value_str = sqlite3_column_text(stmt, 0);
-        numbytes = sqlite3_column_bytes(stmt, 0);
+    update->tstamp = tstamp;
+    update->mode = mode;
+    update->quality = quality;
+}
 
-        if (numbytes >= EVENT_STR_LEN) {
-            META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Event value string will not fit in buffer\n");
-            return SQLITE_ERROR;
+//Remove updates older than tstamp, i.e., what is deleted from NetworkUpdates.
+//All updates are removed (and the cache freed) if tstamp is INT64_MAX
+static void md_inventory_update_expire(struct md_writer_sqlite *mws,
+                                       int64_t tstamp)
+{
+    struct md_inventory_update **prev, *update;
+    uint32_t i;
+
+    if (!mws->last_updates)
+        return;
+
+    for (i = 0; i < LAST_UPDATE_BUCKETS; i++) {
+        prev = &(mws->last_updates[i]);
+
+        while ((update = *prev)) {
+            if (update->tstamp < tstamp) {
+                *prev = update->next;
+                free(update);
+            } else {
+                prev = &(update->next);
+            }
         }
+    }
 
-        memcpy(event_str_cpy, event_value_str, numbytes);
-        event_str_cpy[numbytes] = '\0';
+    if (tstamp == INT64_MAX) {
+        free(mws->last_updates);
+        mws->last_updates = NULL;
+    }
+}
 
-        *mode = metadata_utils_get_csv_pos(event_str_cpy, 2);
-        *quality = metadata_utils_get_csv_pos(event_str_cpy, 3);
-        break;
+uint8_t md_inventory_conn_load_updates(struct md_writer_sqlite *mws)
+{
+    char key[LAST_UPDATE_KEY_LEN];
+    sqlite3_stmt *stmt;
+    int32_t retval, len;
+
+    if (!(mws->last_updates = calloc(LAST_UPDATE_BUCKETS,
+                    sizeof(struct md_inventory_update*)))) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to allocate last "
+                "update cache\n");
+        return RETVAL_FAILURE;
     }
 
-    return retval;
+    if ((retval = sqlite3_prepare_v2(mws->db_handle, SELECT_LAST_UPDATES, -1,
+                    &stmt, NULL))) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Prepare failed %s\n",
+                sqlite3_errstr(retval));
+        return RETVAL_FAILURE;
+    }
+
+    while ((retval = sqlite3_step(stmt)) == SQLITE_ROW) {
+        len = md_inventory_update_key(key, sqlite3_column_int(stmt, 0),
+                sqlite3_column_int(stmt, 1),
+                (const char*) sqlite3_column_text(stmt, 2),
+                (const char*) sqlite3_column_text(stmt, 3),
+                (const char*) sqlite3_column_text(stmt, 4),
+                sqlite3_column_int(stmt, 5),
+                (const char*) sqlite3_column_text(stmt, 6));
+
+        if (len < 0)
+            continue;
+
+        md_inventory_update_store(mws, key, len,
+                sqlite3_column_int64(stmt, 9),
+                sqlite3_column_type(stmt, 7) == SQLITE_NULL ? -1 :
+                    sqlite3_column_int(stmt, 7),
+                sqlite3_column_type(stmt, 8) == SQLITE_NULL ? -1 :
+                    sqlite3_column_int(stmt, 8));
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (retval != SQLITE_DONE) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to read last updates: "
+                "%s\n", sqlite3_errstr(retval));
+        return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+static void md_inventory_get_last_update(struct md_writer_sqlite *mws,
+                                         struct md_conn_event *mce,
+                                         int16_t *mode, int16_t *quality)
+{
+    struct md_inventory_update *update;
+    char key[LAST_UPDATE_KEY_LEN];
+    int32_t len = md_inventory_update_key_mce(mws, mce, key);
+
+    *mode = -1;
+    *quality = -1;
+
+    if (len < 0 || !(update = md_inventory_update_lookup(mws, key,
+                    md_inventory_update_hash(key, len))))
+        return;
+
+    *mode = update->mode;
+    *quality = update->quality;
 }
 
 static void md_inventory_insert_fake_mode(struct md_writer_sqlite *mws,
                                        struct md_conn_event *mce,
                                        uint8_t mode)
 {
+    //The event is shared with the other writers, so work on a copy
+    struct md_conn_event fake_mce = *mce;
     int32_t retval;
 
     //TODO: Not a nice way to access parent variable
-    mce->sequence = mde_inc_seq(mws->parent);
-    mce->event_value = mode;
-    mce->event_param = CONN_EVENT_META_MODE_UPDATE;
+    fake_mce.sequence = mde_inc_seq(mws->parent);
+    fake_mce.event_value = mode;
+    fake_mce.event_param = CONN_EVENT_META_MODE_UPDATE;
 
-    retval = md_inventory_execute_insert(mws, mce);
+    retval = md_inventory_execute_insert(mws, &fake_mce);
 
     if (retval == SQLITE_DONE)
         META_PRINT_SYSLOG(mws->parent, LOG_INFO, "Inserted fake mode update\n");
     else
         META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to insert fake mode update\n");
-
-    //Restore/update query after mode insert
-    mce->event_param = CONN_EVENT_META_UPDATE;
-    mce->event_value = 0;
 }
 
 static void md_inventory_insert_fake_quality(struct md_writer_sqlite *mws,
                                           struct md_conn_event *mce,
                                           uint8_t quality)
 {
+    struct md_conn_event fake_mce = *mce;
     int32_t retval;
 
-    mce->sequence = mde_inc_seq(mws->parent);
-    mce->event_value = quality;
-    mce->event_param = CONN_EVENT_META_QUALITY_UPDATE;
+    fake_mce.sequence = mde_inc_seq(mws->parent);
+    fake_mce.event_value = quality;
+    fake_mce.event_param = CONN_EVENT_META_QUALITY_UPDATE;
 
-    retval = md_inventory_execute_insert(mws, mce);
+    retval = md_inventory_execute_insert(mws, &fake_mce);
 
     if (retval == SQLITE_DONE)
         META_PRINT_SYSLOG(mws->parent, LOG_INFO, "Inserted fake quality update\n");
     else
         META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to insert fake quality update\n");
-
-    //Restore/update query after quality insert
-    mce->event_param = CONN_EVENT_META_UPDATE;
-    mce->event_value = 0;
 }
 
+//Must be called before the update is written to NetworkUpdates, the last
+//update is compared to the one we are about to write
 static void md_inventory_insert_fake_events(struct md_writer_sqlite *mws,
-                                         struct md_conn_event *mce,
-                                         int32_t update_exists)
+                                         struct md_conn_event *mce)
 {
     //TODO: Find a way to respect const
     int16_t mode_in_update = -1, mode_in_table = -1;
@@ -489,6 +614,7 @@ static void md_inventory_insert_fake_events(struct md_writer_sqlite *mws,
         if (t_now.tv_sec > mws->first_fake_update.tv_sec &&
             t_now.tv_sec - mws->first_fake_update.tv_sec > FAKE_UPDATE_LIMIT) {
             mws->do_fake_updates = 0;
+            md_inventory_update_expire(mws, INT64_MAX);
             return;
         }
     } else {
@@ -498,20 +624,10 @@ static void md_inventory_insert_fake_events(struct md_writer_sqlite *mws,
     mode_in_update = mce->connection_mode;
     quality_in_update = mce->quality;
 
-    //If there was no update messge from before, then insert the fake mode/quality messages (just to be sure)
-    //and return
-    if (update_exists == SQLITE_DONE) {
-        //Always insert mode on the first update, for consistency (it should be
-        //possible to follow the mode update messages exclusively)
-        if (mode_in_update)
-            md_inventory_insert_fake_mode(mws, mce, mode_in_update);
-
-        if (quality_in_update)
-            md_inventory_insert_fake_quality(mws, mce, quality_in_update);
-
-        return;
-    }
-
+    //If there is no update message from before, mode/quality in table is -1
+    //and the fake messages are always inserted. Always inserting mode on the
+    //first update is done for consistency (it should be possible to follow the
+    //mode update messages exclusively)
     md_inventory_get_last_update(mws, mce, &mode_in_table, &quality_in_table);
 
     //Get mode from last update message. If we can read modem mode, then this
@@ -523,17 +639,45 @@ static void md_inventory_insert_fake_events(struct md_writer_sqlite *mws,
         md_inventory_insert_fake_quality(mws, mce, quality_in_update);
 }
 
+//Keep the last update cache in sync with NetworkUpdates
+static void md_inventory_update_written(struct md_writer_sqlite *mws,
+                                        struct md_conn_event *mce)
+{
+    char key[LAST_UPDATE_KEY_LEN];
+    int32_t len;
+
+    if (!mws->last_updates)
+        return;
+
+    if ((len = md_inventory_update_key_mce(mws, mce, key)) < 0)
+        return;
+
+    //ConnectionMode is NULL when mode is not known
+    md_inventory_update_store(mws, key, len, mce->tstamp,
+            mce->connection_mode ? mce->connection_mode : -1, mce->quality);
+}
+
 static uint8_t md_inventory_handle_update_event(struct md_writer_sqlite *mws,
                                              struct md_conn_event *mce)
 {
-    //Check if update is present in update table by doing an insert
-    int32_t retval = md_inventory_execute_insert_update(mws, mce);
+    int32_t retval;
 
     if (mws->do_fake_updates)
-        md_inventory_insert_fake_events(mws, mce, retval);
+        md_inventory_insert_fake_events(mws, mce);
+
+    //Check if update is present in update table by doing an insert. With
+    //UPSERT, the insert also updates an existing row
+    retval = md_inventory_execute_insert_update(mws, mce);
+
+    if (mws->use_upsert && retval != SQLITE_DONE) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "UPSERT failed: %s\n",
+                sqlite3_errstr(retval));
+        return RETVAL_FAILURE;
+    }
 
     //No need to do UPDATE if INSERT was successful
     if (retval == SQLITE_DONE) {
+        md_inventory_update_written(mws, mce);
         mws->num_conn_events++;
         return RETVAL_SUCCESS;
     }
@@ -547,6 +691,7 @@ static uint8_t md_inventory_handle_update_event(struct md_writer_sqlite *mws,
         return RETVAL_FAILURE;
     }
 
+    md_inventory_update_written(mws, mce);
     mws->num_conn_events++;
     return RETVAL_SUCCESS;
 }
@@ -571,11 +716,14 @@ static uint8_t md_inventory_handle_usage_update(struct md_writer_sqlite *mws,
 
     META_PRINT_SYSLOG(mws->parent, LOG_ERR, "DATE START %lu\n", date_start);
 
-    retval = md_inventory_execute_update_usage(mws, mce, date_start);
+    //With UPSERT, the insert adds to an existing row
+    if (!mws->use_upsert) {
+        retval = md_inventory_execute_update_usage(mws, mce, date_start);
 
-    if (retval == SQLITE_DONE && sqlite3_changes(mws->db_handle)) {
-        mws->num_usage_events++;
-        return RETVAL_SUCCESS;
+        if (retval == SQLITE_DONE && sqlite3_changes(mws->db_handle)) {
+            mws->num_usage_events++;
+            return RETVAL_SUCCESS;
+        }
     }
 
     retval = md_inventory_execute_insert_usage(mws, mce, date_start);
@@ -612,7 +760,7 @@ uint8_t md_inventory_handle_conn_event(struct md_writer_sqlite *mws,
 
 static uint8_t md_inventory_conn_dump_db_json(struct md_writer_sqlite *mws, FILE *output)
 {
-    const char *json_str;
+    sqlite3_stmt *stmts[] = {mws->dump_table, mws->dump_update};
 
     sqlite3_reset(mws->dump_table);
     sqlite3_reset(mws->dump_update);
@@ -620,24 +768,7 @@ static uint8_t md_inventory_conn_dump_db_json(struct md_writer_sqlite *mws, FILE
     sqlite3_bind_int64(mws->dump_table, 1, mws->dump_tstamp);
     sqlite3_bind_int64(mws->dump_update, 1, mws->dump_tstamp);
 
-    json_object *jarray = json_object_new_array();
-
-    if (md_json_helpers_dump_write(mws->dump_table, jarray))
-    {
-        json_object_put(jarray);
-        return RETVAL_FAILURE;
-    }
-
-    if (md_json_helpers_dump_write(mws->dump_update, jarray))
-    {
-        json_object_put(jarray);
-        return RETVAL_FAILURE;
-    }
-
-    json_str = json_object_to_json_string_ext(jarray, JSON_C_TO_STRING_PLAIN);
-    fprintf(output, "%s", json_str);
-    json_object_put(jarray);
-    return RETVAL_SUCCESS;
+    return md_json_helpers_dump_write(output, stmts, 2);
 }
 
 static uint8_t md_inventory_conn_delete_db(struct md_writer_sqlite *mws)
@@ -684,28 +815,16 @@ static uint8_t md_inventory_conn_delete_db(struct md_writer_sqlite *mws)
         return RETVAL_FAILURE;
     }
 
+    md_inventory_update_expire(mws, mws->last_msg_tstamp - 1800);
     mws->delete_conn_update = 0;
     return RETVAL_SUCCESS;
 }
 
 static uint8_t md_inventory_usage_dump_db_json(struct md_writer_sqlite *mws, FILE *output)
 {
-    const char *json_str;
     sqlite3_reset(mws->dump_usage);
 
-    json_object *jarray = json_object_new_array();
-
-    if (md_json_helpers_dump_write(mws->dump_usage, jarray))
-    {
-        json_object_put(jarray);
-        return RETVAL_FAILURE;
-    }
-
-    json_str = json_object_to_json_string_ext(jarray, JSON_C_TO_STRING_PLAIN);
-    fprintf(output, "%s", json_str);
-
-    json_object_put(jarray);
-    return RETVAL_SUCCESS;
+    return md_json_helpers_dump_write(output, &(mws->dump_usage), 1);
 }
 
 static uint8_t md_inventory_usage_delete_db(struct md_writer_sqlite *mws)
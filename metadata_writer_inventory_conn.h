@@ -31,10 +31,31 @@
 #include "metadata_writer_sqlite.h"
 
 #define UPDATE_STR_LEN  8
+//Number of buckets in the last update cache. There is one entry per active
+//session (address on an interface), so this is plenty
+#define LAST_UPDATE_BUCKETS     64
+#define LAST_UPDATE_KEY_LEN     256
+
+//Mode and quality of the last update written to NetworkUpdates, keyed on the
+//same columns as UPDATE_UPDATE. Replaces a SELECT per update when checking if
+//fake mode/quality events are needed. The cache is only kept while fake events
+//are inserted
+struct md_inventory_update {
+    struct md_inventory_update *next;
+    int64_t tstamp;
+    uint32_t hash;
+    //-1 if not set
+    int16_t mode;
+    int16_t quality;
+    char key[];
+};
 
 uint8_t md_inventory_handle_conn_event(struct md_writer_sqlite *mws,
                                     struct md_conn_event *mce);
 uint8_t md_inventory_conn_copy_db(struct md_writer_sqlite *mws);
 uint8_t md_inventory_conn_usage_copy_db(struct md_writer_sqlite *mws);
 
+//Create the last update cache and fill it from NetworkUpdates
+uint8_t md_inventory_conn_load_updates(struct md_writer_sqlite *mws);
+
 #endif
@@ -25,56 +25,130 @@
  */
 #include <json-c/json.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
 #include <sqlite3.h>
 
 #include "metadata_exporter.h"
+#include "metadata_writer_json_helpers.h"
 
-uint8_t md_json_helpers_dump_write(sqlite3_stmt *stmt, json_object *jarray)
+//Escaping follows json-c (including escaped '/'), so that the output is the
+//same as when the rows were serialized with json_object_to_json_string_ext()
+static void md_json_helpers_write_str(FILE *output, const char *str)
 {
-    int32_t retval;
-    int32_t column_count, i = 0;
+    const char *run = str;
+    unsigned char c;
 
-    while ((retval = sqlite3_step(stmt)) == SQLITE_ROW) {
-        json_object *json = json_object_new_object();
-        if (json == NULL)
-            return RETVAL_FAILURE;
+    fputc('"', output);
 
-        column_count = sqlite3_column_count(stmt);
+    for (; (c = *str); str++) {
+        if (c >= 0x20 && c != '"' && c != '\\' && c != '/')
+            continue;
 
-        for (i = 0; i < column_count; i++)
-        {
-            json_object *object = NULL;
+        fwrite(run, 1, str - run, output);
+        run = str + 1;
 
-            switch (sqlite3_column_type(stmt, i))
-            {
-                case SQLITE_INTEGER:
-                    object = json_object_new_int64(sqlite3_column_int64(stmt, i));
-                    break;
+        switch (c) {
+        case '\b':
+            fputs("\\b", output);
+            break;
+        case '\n':
+            fputs("\\n", output);
+            break;
+        case '\r':
+            fputs("\\r", output);
+            break;
+        case '\t':
+            fputs("\\t", output);
+            break;
+        case '\f':
+            fputs("\\f", output);
+            break;
+        case '"':
+        case '\\':
+        case '/':
+            fputc('\\', output);
+            fputc(c, output);
+            break;
+        default:
+            fprintf(output, "\\u%04x", c);
+            break;
+        }
+    }
 
-                case SQLITE_TEXT:
-                    object = json_object_new_string((const char *)sqlite3_column_text(stmt, i));
-                    break;
+    fwrite(run, 1, str - run, output);
+    fputc('"', output);
+}
 
-                case SQLITE_FLOAT:
-                    object = json_object_new_double(sqlite3_column_double(stmt, i));
-                    break;
+static void md_json_helpers_write_double(FILE *output, double value)
+{
+    char buf[32];
 
-                case SQLITE_NULL:
-                    continue;
-            }
+    //Not valid JSON
+    if (!isfinite(value)) {
+        fputs("null", output);
+        return;
+    }
 
-            if (object == NULL) {
-                json_object_put(json);
+    snprintf(buf, sizeof(buf), "%.17g", value);
+    fputs(buf, output);
+
+    //Keep the value a double when it is read back
+    if (!strpbrk(buf, ".e"))
+        fputs(".0", output);
+}
+
+static uint8_t md_json_helpers_write_rows(sqlite3_stmt *stmt, FILE *output,
+                                          uint8_t *first_row)
+{
+    int32_t retval, column_count, i;
+    uint8_t first_col;
+
+    column_count = sqlite3_column_count(stmt);
+
+    while ((retval = sqlite3_step(stmt)) == SQLITE_ROW) {
+        first_col = 1;
+
+        for (i = 0; i < column_count; i++) {
+            //Type must be checked before the value is read, reading converts
+            switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_NULL:
+                continue;
+            case SQLITE_BLOB:
                 return RETVAL_FAILURE;
             }
 
-            json_object_object_add(json, sqlite3_column_name(stmt, i),object);
+            if (first_col) {
+                fputs(*first_row ? "{" : ",{", output);
+                *first_row = 0;
+                first_col = 0;
+            } else {
+                fputc(',', output);
+            }
+
+            md_json_helpers_write_str(output, sqlite3_column_name(stmt, i));
+            fputc(':', output);
+
+            switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER:
+                fprintf(output, "%" PRId64,
+                        (int64_t) sqlite3_column_int64(stmt, i));
+                break;
+            case SQLITE_FLOAT:
+                md_json_helpers_write_double(output,
+                        sqlite3_column_double(stmt, i));
+                break;
+            default:
+                md_json_helpers_write_str(output,
+                        (const char *) sqlite3_column_text(stmt, i));
+                break;
+            }
         }
 
-        if (json_object_object_length(json) > 0)
-            json_object_array_add(jarray, json);
-        else
-            json_object_put(json);
+        //Rows where every column is NULL are skipped
+        if (!first_col)
+            fputc('}', output);
     }
 
     if (retval != SQLITE_DONE)
@@ -82,3 +156,20 @@ uint8_t md_json_helpers_dump_write(sqlite3_stmt *stmt, json_object *jarray)
     else
         return RETVAL_SUCCESS;
 }
+
+uint8_t md_json_helpers_dump_write(FILE *output, sqlite3_stmt **stmts,
+                                   uint8_t num_stmts)
+{
+    uint8_t first_row = 1, i;
+
+    fputc('[', output);
+
+    for (i = 0; i < num_stmts; i++) {
+        if (md_json_helpers_write_rows(stmts[i], output, &first_row))
+            return RETVAL_FAILURE;
+    }
+
+    fputc(']', output);
+
+    return ferror(output) ? RETVAL_FAILURE : RETVAL_SUCCESS;
+}
@@ -27,9 +27,14 @@
 #ifndef METADATA_WRITER_JSON_HELPERS_H
 #define METADATA_WRITER_JSON_HELPERS_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <sqlite3.h>
 
-uint8_t md_json_helpers_dump_write(sqlite3_stmt *stmt, json_object *jarray);
+//Step the statements and write all rows to output as one JSON array, one
+//object (column name -> value) per row. NULL columns are left out. Rows are
+//written as they are read, so memory use does not depend on the number of rows
+uint8_t md_json_helpers_dump_write(FILE *output, sqlite3_stmt **stmts,
+                                   uint8_t num_stmts);
 
 #endif
@@ -289,6 +289,9 @@ static int32_t md_neat_init(void *ptr, json_object* config)
             }
         }
     }
+
+    mde_writer_subscribe((struct md_writer*) mwn, META_TYPE_INTERFACE,
+            MD_EVENT_PARAM_ALL);
     
     return RETVAL_SUCCESS;
 }
@@ -1183,9 +1183,19 @@ static int32_t md_nne_init(void *ptr, json_object* config)
         return RETVAL_FAILURE;
     }
 
-    mde_start_timer(mwn->parent->event_loop, mwn->timeout_handle,
+    mwn->timeout_handle->name = "nne export";
+    //Exporting a little late is fine, allow up to 10% of the interval
+    mwn->timeout_handle->slack = mwn->interval / 10;
+    mde_start_timer(mwn->event_loop, mwn->timeout_handle,
                     mwn->interval);
 
+    mde_writer_subscribe((struct md_writer*) mwn, META_TYPE_POS,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwn, META_TYPE_INTERFACE,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwn, META_TYPE_RADIO,
+            MD_EVENT_PARAM_ALL);
+
     return RETVAL_SUCCESS;
 }
 
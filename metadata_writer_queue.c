@@ -0,0 +1,296 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "metadata_exporter.h"
+#include "metadata_exporter_log.h"
+#include "metadata_writer_queue.h"
+#include "metadata_event.h"
+#include "backend_event_loop.h"
+
+static void md_writer_queue_handle_events(void *ptr, int32_t fd,
+                                          uint32_t events)
+{
+    struct md_writer_queue *mwq = ptr;
+    struct md_writer *writer = mwq->writer;
+    struct md_event *burst[MD_WRITER_QUEUE_BURST];
+    uint32_t num_events, i;
+    uint64_t num_wakeups;
+
+    //Counter is only used for waking up the thread, value is not interesting
+    if (read(fd, &num_wakeups, sizeof(num_wakeups)) < 0 && errno != EAGAIN) {
+        META_PRINT_SYSLOG(writer->parent, LOG_ERR, "Failed to read %s queue "
+                "eventfd: %s\n", mwq->name, strerror(errno));
+    }
+
+    //Empty the queue in bursts, so that the lock is not held while the writer
+    //is working and the inputs can keep adding events
+    while (1) {
+        pthread_mutex_lock(&(mwq->lock));
+        for (num_events = 0; num_events < MD_WRITER_QUEUE_BURST && mwq->count;
+                num_events++) {
+            burst[num_events] = mwq->events[mwq->head];
+            mwq->head = (mwq->head + 1) % mwq->size;
+            mwq->count--;
+        }
+
+        if (num_events && mwq->policy == MD_WRITER_QUEUE_BLOCK)
+            pthread_cond_broadcast(&(mwq->not_full));
+        pthread_mutex_unlock(&(mwq->lock));
+
+        if (!num_events)
+            break;
+
+        if (writer->handle_batch != NULL) {
+            writer->handle_batch(writer, burst, num_events);
+        } else {
+            for (i = 0; i < num_events; i++)
+                writer->handle(writer, burst[i]);
+        }
+
+        for (i = 0; i < num_events; i++)
+            md_event_put(burst[i]);
+    }
+}
+
+//Try to replace a queued event with the same key, called with lock held. We
+//search from the tail since the newest events are most likely to match.
+//Returns the replaced event, which must be released by the caller
+static struct md_event* md_writer_queue_conflate(struct md_writer_queue *mwq,
+                                                 struct md_event *event)
+{
+    struct md_event *queued;
+    uint32_t i, idx;
+
+    for (i = mwq->count; i > 0; i--) {
+        idx = (mwq->head + i - 1) % mwq->size;
+        queued = mwq->events[idx];
+
+        if (md_event_conflates(queued, event)) {
+            mwq->events[idx] = event;
+            return queued;
+        }
+    }
+
+    return NULL;
+}
+
+void md_writer_queue_push(struct md_writer_queue *mwq, struct md_event *event)
+{
+    struct md_event *dropped = NULL;
+    uint64_t wakeup = 1;
+    uint8_t was_empty;
+
+    pthread_mutex_lock(&(mwq->lock));
+
+    //Most events can never be conflated, no need to scan the queue for them
+    if (mwq->policy == MD_WRITER_QUEUE_CONFLATE &&
+        md_event_is_conflatable(event) &&
+        (dropped = md_writer_queue_conflate(mwq, event))) {
+        mwq->stats.conflated++;
+        pthread_mutex_unlock(&(mwq->lock));
+        //Replaced event was in the queue, so writer is already woken up
+        md_event_put(dropped);
+        return;
+    }
+
+    if (mwq->count == mwq->size) {
+        if (mwq->policy == MD_WRITER_QUEUE_BLOCK) {
+            mwq->stats.blocked++;
+
+            while (mwq->count == mwq->size)
+                pthread_cond_wait(&(mwq->not_full), &(mwq->lock));
+        } else if (mwq->policy == MD_WRITER_QUEUE_DROP_NEWEST) {
+            mwq->stats.dropped++;
+            pthread_mutex_unlock(&(mwq->lock));
+            md_event_put(event);
+            return;
+        } else {
+            //Drop oldest, also used for conflate when no match was found
+            dropped = mwq->events[mwq->head];
+            mwq->head = (mwq->head + 1) % mwq->size;
+            mwq->count--;
+            mwq->stats.dropped++;
+        }
+    }
+
+    was_empty = mwq->count == 0;
+    mwq->events[(mwq->head + mwq->count) % mwq->size] = event;
+    mwq->count++;
+    mwq->stats.enqueued++;
+
+    if (mwq->count > mwq->stats.max_depth)
+        mwq->stats.max_depth = mwq->count;
+
+    pthread_mutex_unlock(&(mwq->lock));
+
+    //Release outside of the lock, freeing a json blob can take some time
+    if (dropped)
+        md_event_put(dropped);
+
+    //Writer thread will empty the queue before it goes back to sleep, so we
+    //only need to wake it up when the first event is added
+    if (was_empty && write(mwq->efd, &wakeup, sizeof(wakeup)) < 0) {
+        META_PRINT_SYSLOG(mwq->writer->parent, LOG_ERR, "Failed to wake up "
+                "%s writer: %s\n", mwq->name, strerror(errno));
+    }
+}
+
+void md_writer_queue_log_stats(struct md_writer_queue *mwq)
+{
+    struct md_writer_queue_stats stats;
+    uint32_t count;
+
+    pthread_mutex_lock(&(mwq->lock));
+    stats = mwq->stats;
+    count = mwq->count;
+    pthread_mutex_unlock(&(mwq->lock));
+
+    if (stats.dropped == mwq->last_stats.dropped &&
+        stats.conflated == mwq->last_stats.conflated &&
+        stats.blocked == mwq->last_stats.blocked)
+        return;
+
+    META_PRINT_SYSLOG(mwq->writer->parent, LOG_WARNING, "Writer %s is backed "
+            "up. Queued %u/%u (max %u) enqueued %" PRIu64 " dropped %" PRIu64
+            " (+%" PRIu64 ") conflated %" PRIu64 " (+%" PRIu64 ") blocked %"
+            PRIu64 " (+%" PRIu64 ")\n", mwq->name, count, mwq->size,
+            stats.max_depth, stats.enqueued, stats.dropped,
+            stats.dropped - mwq->last_stats.dropped, stats.conflated,
+            stats.conflated - mwq->last_stats.conflated, stats.blocked,
+            stats.blocked - mwq->last_stats.blocked);
+
+    mwq->last_stats = stats;
+}
+
+static uint8_t md_writer_queue_config(struct md_writer_queue *mwq,
+                                      json_object *config)
+{
+    json_object *subconfig;
+    const char *policy;
+    int32_t size;
+
+    mwq->size = MD_WRITER_QUEUE_DEFAULT_SIZE;
+    mwq->policy = MD_WRITER_QUEUE_BLOCK;
+
+    if (!json_object_object_get_ex(config, mwq->name, &subconfig))
+        return RETVAL_SUCCESS;
+
+    json_object_object_foreach(subconfig, key, val) {
+        if (!strcmp(key, "queue_size")) {
+            size = json_object_get_int(val);
+
+            if (size <= 0) {
+                META_PRINT_SYSLOG(mwq->writer->parent, LOG_ERR, "Invalid "
+                        "queue size for %s writer\n", mwq->name);
+                return RETVAL_FAILURE;
+            }
+
+            mwq->size = size;
+        } else if (!strcmp(key, "queue_policy")) {
+            policy = json_object_get_string(val);
+
+            if (!strcmp(policy, "block")) {
+                mwq->policy = MD_WRITER_QUEUE_BLOCK;
+            } else if (!strcmp(policy, "drop_oldest")) {
+                mwq->policy = MD_WRITER_QUEUE_DROP_OLDEST;
+            } else if (!strcmp(policy, "drop_newest")) {
+                mwq->policy = MD_WRITER_QUEUE_DROP_NEWEST;
+            } else if (!strcmp(policy, "conflate")) {
+                mwq->policy = MD_WRITER_QUEUE_CONFLATE;
+            } else {
+                META_PRINT_SYSLOG(mwq->writer->parent, LOG_ERR, "Unknown queue "
+                        "policy %s for %s writer\n", policy, mwq->name);
+                return RETVAL_FAILURE;
+            }
+        }
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+struct md_writer_queue* md_writer_queue_create(struct md_writer *writer,
+                                               const char *name,
+                                               json_object *config)
+{
+    struct md_writer_queue *mwq = calloc(sizeof(struct md_writer_queue), 1);
+
+    if (mwq == NULL)
+        return NULL;
+
+    mwq->writer = writer;
+    mwq->name = name;
+    pthread_mutex_init(&(mwq->lock), NULL);
+    pthread_cond_init(&(mwq->not_full), NULL);
+
+    if (md_writer_queue_config(mwq, config))
+        return NULL;
+
+    if (!(mwq->events = calloc(mwq->size, sizeof(struct md_event*))))
+        return NULL;
+
+    if ((mwq->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        META_PRINT_SYSLOG(writer->parent, LOG_ERR, "Failed to create eventfd "
+                "for %s writer: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    if (!(mwq->event_handle = backend_create_epoll_handle(mwq, mwq->efd,
+                    md_writer_queue_handle_events)))
+        return NULL;
+
+    mwq->event_handle->name = name;
+
+    //The eventfd counter is reset by one read and the queue is always emptied,
+    //so the handler is safe to use with EPOLLET
+    if (backend_event_loop_update(writer->event_loop, EPOLLIN | EPOLLET, EPOLL_CTL_ADD,
+                mwq->efd, mwq->event_handle)) {
+        META_PRINT_SYSLOG(writer->parent, LOG_ERR, "Failed to add %s writer "
+                "eventfd to loop\n", name);
+        return NULL;
+    }
+
+    return mwq;
+}
+
+void md_writer_queue_usage()
+{
+    fprintf(stderr, "Every writer also accepts:\n");
+    fprintf(stderr, "  \"loop\":\t\tname of event loop/thread to run on (default: name of writer)\n");
+    fprintf(stderr, "  \"queue_size\":\t\tmax number of events waiting for the writer (default: %u)\n",
+            MD_WRITER_QUEUE_DEFAULT_SIZE);
+    fprintf(stderr, "  \"queue_policy\":\twhat to do when queue is full. block (default), drop_oldest,\n");
+    fprintf(stderr, "\t\t\tdrop_newest or conflate (replace older signal/update event for same IMEI)\n");
+}
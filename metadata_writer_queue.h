@@ -0,0 +1,107 @@
+/* Copyright (c) 2015, Celerway, Kristian Evensen <kristrev@celerway.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include JSON_LOC
+
+#define MD_WRITER_QUEUE_DEFAULT_SIZE    1024
+//Max number of events taken out of the queue while holding the lock
+#define MD_WRITER_QUEUE_BURST           32
+
+struct md_writer;
+struct md_event;
+struct backend_event_loop;
+struct backend_epoll_handle;
+
+//What to do when an event is added to a full queue
+enum md_writer_queue_policy {
+    //Wait until the writer has made room. Nothing is lost, but a stalled
+    //writer will stall the inputs (and thus all other writers)
+    MD_WRITER_QUEUE_BLOCK,
+    //Drop the oldest event in the queue
+    MD_WRITER_QUEUE_DROP_OLDEST,
+    //Drop the event that is being added
+    MD_WRITER_QUEUE_DROP_NEWEST,
+    //A queued event with the same key is replaced by the new one, see
+    //md_event_conflates(). If there is no such event and the queue is full,
+    //the oldest event is dropped
+    MD_WRITER_QUEUE_CONFLATE,
+};
+
+struct md_writer_queue_stats {
+    uint64_t enqueued;
+    uint64_t dropped;
+    uint64_t conflated;
+    uint64_t blocked;
+    uint32_t max_depth;
+};
+
+//Writers run on a different thread than the inputs (by default, every writer
+//gets its own loop and thread). Events are passed from the input thread(s)
+//through a bounded queue, and an eventfd is used to wake up the writer's loop.
+//Timers used by a writer must be added to the writer's loop
+//(writer->event_loop), never to the main loop
+struct md_writer_queue {
+    struct md_writer *writer;
+    struct backend_epoll_handle *event_handle;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+
+    //Ring buffer of events
+    struct md_event **events;
+    uint32_t size;
+    uint32_t head;
+    uint32_t count;
+    uint8_t policy;
+
+    struct md_writer_queue_stats stats;
+    //Stats at the time of the last report, used to only log changes
+    struct md_writer_queue_stats last_stats;
+
+    int32_t efd;
+    //Config key of writer, used in log messages
+    const char *name;
+};
+
+//Create queue and eventfd for writer, and add the eventfd to
+//writer->event_loop. Queue size and policy are read from the writer's config
+//object
+struct md_writer_queue* md_writer_queue_create(struct md_writer *writer,
+                                               const char *name,
+                                               json_object *config);
+
+//Add an event to the queue. The queue takes over the reference, also when the
+//event is dropped
+void md_writer_queue_push(struct md_writer_queue *mwq, struct md_event *event);
+
+//Log queue counters if events have been dropped/conflated since last call
+void md_writer_queue_log_stats(struct md_writer_queue *mwq);
+
+void md_writer_queue_usage();
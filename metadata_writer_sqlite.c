@@ -30,6 +30,9 @@
 #include <getopt.h>
 #include <libmnl/libmnl.h>
 #include <string.h>
+#include <ctype.h>
+#include <strings.h>
+#include <inttypes.h>
 #include <sys/time.h>
 #include <time.h>
 #include <stdlib.h>
@@ -52,12 +55,95 @@ static void md_sqlite_copy_db(struct md_writer_sqlite *mws, uint8_t from_timeout
 static void md_sqlite_handle_timeout(void *ptr);
 static void md_sqlite_handle(struct md_writer *writer, struct md_event *event);
 
-static void md_sqlite_itr_cb(void *ptr)
+static uint8_t md_sqlite_exec(struct md_writer_sqlite *mws, const char *sql)
+{
+    char *db_errmsg = NULL;
+
+    if (sqlite3_exec(mws->db_handle, sql, NULL, NULL, &db_errmsg)) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "%s failed: %s\n", sql,
+                db_errmsg);
+        sqlite3_free(db_errmsg);
+        return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+//With WAL, the checkpoint is done when the loop is idle, instead of by the
+//commit that happens to cross the automatic threshold
+static void md_sqlite_checkpoint_task(void *ptr)
+{
+    struct md_writer_sqlite *mws = ptr;
+    int log_frames, ckpt_frames;
+
+    //Our own transaction blocks the checkpoint, the WAL hook schedules a new
+    //one when it is committed
+    if (mws->in_tx)
+        return;
+
+    if (sqlite3_wal_checkpoint_v2(mws->db_handle, NULL,
+                SQLITE_CHECKPOINT_PASSIVE, &log_frames, &ckpt_frames))
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "WAL checkpoint failed: %s\n",
+                sqlite3_errmsg(mws->db_handle));
+}
+
+//Called after every commit, replaces SQLite's automatic checkpoint
+static int md_sqlite_wal_hook(void *ptr, sqlite3 *db_handle,
+                              const char *db_name, int num_frames)
+{
+    struct md_writer_sqlite *mws = ptr;
+
+    if ((uint32_t) num_frames >= mws->wal_frames)
+        backend_schedule_task(mws->event_loop, &(mws->checkpoint_task),
+                BACKEND_TASK_IDLE);
+
+    return SQLITE_OK;
+}
+
+//A commit (and thus a journal sync) per event is what limits the number of
+//events we can store per second, and what wears out the flash. If BEGIN fails,
+//events are inserted in autocommit mode
+static void md_sqlite_tx_begin(struct md_writer_sqlite *mws)
+{
+    if (mws->in_tx || md_sqlite_exec(mws, "BEGIN"))
+        return;
+
+    mws->in_tx = 1;
+    mws->tx_pending = 0;
+
+    if (mws->tx_interval)
+        mde_start_timer(mws->event_loop, mws->tx_timeout_handle,
+                mws->tx_interval);
+}
+
+static void md_sqlite_tx_commit(struct md_writer_sqlite *mws)
+{
+    if (!mws->in_tx)
+        return;
+
+    if (mws->tx_interval)
+        backend_remove_timeout(mws->tx_timeout_handle);
+
+    md_sqlite_exec(mws, "COMMIT");
+
+    //A failed COMMIT can leave the transaction open, then we try again on the
+    //next commit
+    mws->in_tx = !sqlite3_get_autocommit(mws->db_handle);
+}
+
+static void md_sqlite_handle_tx_timeout(void *ptr)
+{
+    md_sqlite_tx_commit(ptr);
+}
+
+//Scheduled when a DB dump fails. Runs after the current callback, so that
+//md_sqlite_handle_timeout() has reset the export timer
+static void md_sqlite_retry_task(void *ptr)
 {
     struct md_writer_sqlite *mws = ptr;
 
     if (mws->file_failed && !mws->timeout_added) {
-        mde_start_timer(mws->parent->event_loop,
+        mde_start_timer(mws->event_loop,
                         mws->timeout_handle,
                         TIMEOUT_FILE);
         mws->timeout_added = 1; 
@@ -69,6 +155,9 @@ static void md_sqlite_copy_db(struct md_writer_sqlite *mws, uint8_t from_timeout
     uint8_t retval = RETVAL_FAILURE;
     uint8_t num_failed = 0;
 
+    //Events must be on disk before they are exported and deleted
+    md_sqlite_tx_commit(mws);
+
     if (!mws->node_id || !mws->valid_timestamp ||
             (mws->session_id_file && !mws->session_id))
     {
@@ -132,6 +221,8 @@ static void md_sqlite_copy_db(struct md_writer_sqlite *mws, uint8_t from_timeout
     if (num_failed != 0) {
         META_PRINT_SYSLOG(mws->parent, LOG_ERR, "%u DB dump(s) failed\n", num_failed);
         mws->file_failed = 1;
+        backend_schedule_task(mws->event_loop, &(mws->retry_task),
+                BACKEND_TASK_NEXT);
     } else {
         mws->file_failed = 0;
     }
@@ -245,7 +336,7 @@ static sqlite3* md_sqlite_configure_db(struct md_writer_sqlite *mws, const char
     char *db_errmsg = NULL;
 
     retval = sqlite3_open_v2(db_filename, &db_handle, SQLITE_OPEN_READWRITE |
-                             SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL);
+                             SQLITE_OPEN_CREATE | mws->mutex_flag, NULL);
 
     if (retval != SQLITE_OK) {
         if (db_handle != NULL)
@@ -256,6 +347,17 @@ static sqlite3* md_sqlite_configure_db(struct md_writer_sqlite *mws, const char
         return NULL;
     }
 
+    if (mws->pragmas[0] && sqlite3_exec(db_handle, mws->pragmas, NULL, NULL,
+                &db_errmsg)) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "db pragmas failed with message: %s\n", db_errmsg);
+        sqlite3_close_v2(db_handle);
+        return NULL;
+    }
+
+    //Must be set after the pragmas, wal_autocheckpoint replaces the hook
+    if (mws->wal_checkpoint)
+        sqlite3_wal_hook(db_handle, md_sqlite_wal_hook, mws);
+
     //make sure database is ready to be used. this avoids having checks in
     //metadata_produce, since it will first export any message stored in
     //database
@@ -345,7 +447,8 @@ static void md_sqlite_get_real_boot_time(struct md_writer_sqlite *mws, uint64_t
 
 static int md_sqlite_configure(struct md_writer_sqlite *mws,
         const char *db_filename, uint32_t node_id, uint32_t db_interval,
-        uint32_t db_events, const char *meta_prefix, const char *gps_prefix,
+        uint32_t db_events, uint32_t tx_interval, uint32_t tx_events,
+        const char *meta_prefix, const char *gps_prefix,
         const char *monitor_prefix, const char *usage_prefix,
         const char *system_prefix, const char *ntp_fix_file)
 {
@@ -366,6 +469,8 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
     mws->db_handle = db_handle;
     mws->db_interval = db_interval;
     mws->db_events = db_events;
+    mws->tx_interval = tx_interval;
+    mws->tx_events = tx_events;
     mws->do_fake_updates = 1;
     mws->delete_conn_update = 1;
 
@@ -376,16 +481,41 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
         return RETVAL_FAILURE;
     }
 
+    mws->timeout_handle->name = "sqlite export";
+    //Exporting a little late is fine, allow up to 10% of the interval
+    mws->timeout_handle->slack = mws->db_interval / 10;
+    backend_task_init(&(mws->retry_task), md_sqlite_retry_task, mws,
+            "sqlite retry");
+    backend_task_init(&(mws->checkpoint_task), md_sqlite_checkpoint_task, mws,
+            "sqlite checkpoint");
+
+    if(!(mws->tx_timeout_handle = backend_event_loop_create_timeout(0,
+            md_sqlite_handle_tx_timeout, mws, 0))) {
+        sqlite3_close_v2(db_handle);
+        return RETVAL_FAILURE;
+    }
+
+    mws->tx_timeout_handle->name = "sqlite commit";
+    mws->tx_timeout_handle->slack = mws->tx_interval / 10;
+
+    //UPSERT replaces the INSERT + UPDATE pairs, which cost two statements (one
+    //failing) per update/usage event
+    mws->use_upsert = sqlite3_libversion_number() >= UPSERT_SQLITE_VERSION;
+
+    if (!mws->use_upsert)
+        META_PRINT_SYSLOG(mws->parent, LOG_INFO, "SQLite %s has no UPSERT, "
+                "using INSERT + UPDATE\n", sqlite3_libversion());
+
     if(sqlite3_prepare_v2(mws->db_handle, INSERT_EVENT, -1,
             &(mws->insert_event), NULL) ||
        sqlite3_prepare_v2(mws->db_handle, DELETE_TABLE, -1,
             &(mws->delete_table), NULL) ||
-       sqlite3_prepare_v2(mws->db_handle, INSERT_UPDATE, -1,
+       sqlite3_prepare_v2(mws->db_handle,
+            mws->use_upsert ? UPSERT_UPDATE : INSERT_UPDATE, -1,
             &(mws->insert_update), NULL) ||
-       sqlite3_prepare_v2(mws->db_handle, UPDATE_UPDATE, -1,
-            &(mws->update_update), NULL) ||
-       sqlite3_prepare_v2(mws->db_handle, SELECT_LAST_UPDATE, -1,
-            &(mws->last_update), NULL) ||
+       (!mws->use_upsert &&
+        sqlite3_prepare_v2(mws->db_handle, UPDATE_UPDATE, -1,
+            &(mws->update_update), NULL)) ||
        sqlite3_prepare_v2(mws->db_handle, INSERT_GPS_EVENT, -1,
             &(mws->insert_gps), NULL) ||
        sqlite3_prepare_v2(mws->db_handle, DELETE_GPS_TABLE, -1,
@@ -398,10 +528,12 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
             &(mws->delete_monitor), NULL) ||
        sqlite3_prepare_v2(mws->db_handle, DUMP_MONITOR_JSON, -1,
             &(mws->dump_monitor), NULL) ||
-       sqlite3_prepare_v2(mws->db_handle, INSERT_USAGE, -1,
+       sqlite3_prepare_v2(mws->db_handle,
+            mws->use_upsert ? UPSERT_USAGE : INSERT_USAGE, -1,
             &(mws->insert_usage), NULL) ||
-       sqlite3_prepare_v2(mws->db_handle, UPDATE_USAGE, -1,
-            &(mws->update_usage), NULL) ||
+       (!mws->use_upsert &&
+        sqlite3_prepare_v2(mws->db_handle, UPDATE_USAGE, -1,
+            &(mws->update_usage), NULL)) ||
        sqlite3_prepare_v2(mws->db_handle, DUMP_USAGE_JSON, -1,
             &(mws->dump_usage), NULL) ||
        sqlite3_prepare_v2(mws->db_handle, DELETE_USAGE_TABLE, -1,
@@ -428,6 +560,11 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
         return RETVAL_FAILURE;
     }
 
+    if (md_inventory_conn_load_updates(mws)) {
+        sqlite3_close_v2(db_handle);
+        return RETVAL_FAILURE;
+    }
+
     if (meta_prefix) {
         memset(mws->meta_prefix, 0, sizeof(mws->meta_prefix));
         memcpy(mws->meta_prefix, meta_prefix, strlen(meta_prefix));
@@ -473,6 +610,21 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
         mws->system_prefix_len = strlen(system_prefix);
     }
 
+    //Data usage is a connection event, but only stored if usage_prefix is set
+    if (mws->meta_prefix[0])
+        mde_writer_subscribe((struct md_writer*) mws, META_TYPE_CONNECTION,
+                mws->usage_prefix[0] ? MD_EVENT_PARAM_ALL :
+                ~MD_EVENT_PARAM(CONN_EVENT_DATA_USAGE_UPDATE));
+    if (mws->gps_prefix[0])
+        mde_writer_subscribe((struct md_writer*) mws, META_TYPE_POS,
+                MD_EVENT_PARAM_ALL);
+    if (mws->monitor_prefix[0])
+        mde_writer_subscribe((struct md_writer*) mws, META_TYPE_MUNIN,
+                MD_EVENT_PARAM_ALL);
+    if (mws->system_prefix[0])
+        mde_writer_subscribe((struct md_writer*) mws, META_TYPE_SYSTEM,
+                MD_EVENT_PARAM_ALL);
+
     if (ntp_fix_file) {
         memset(mws->ntp_fix_file, 0, sizeof(mws->ntp_fix_file));
         memcpy(mws->ntp_fix_file, ntp_fix_file, strlen(ntp_fix_file));
@@ -498,6 +650,121 @@ static int md_sqlite_configure(struct md_writer_sqlite *mws,
     return md_sqlite_read_orig_boot_time(mws);
 }
 
+//PRAGMAs that can be set in the pragmas object. Values are pasted into the
+//statement, so only numbers and names are accepted
+static const char *md_sqlite_pragma_names[] = {
+    "journal_mode",
+    "synchronous",
+    "mmap_size",
+    "cache_size",
+    "temp_store",
+};
+
+#define MD_SQLITE_NUM_PRAGMAS \
+    (sizeof(md_sqlite_pragma_names) / sizeof(md_sqlite_pragma_names[0]))
+
+static uint8_t md_sqlite_append_pragma(struct md_writer_sqlite *mws,
+                                       const char *key, const char *value)
+{
+    size_t len = strlen(mws->pragmas);
+    int retval = snprintf(mws->pragmas + len, sizeof(mws->pragmas) - len,
+            "PRAGMA %s=%s;", key, value);
+
+    if (retval < 0 || (size_t) retval >= sizeof(mws->pragmas) - len) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Too many SQLite pragmas\n");
+        return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
+}
+
+static uint8_t md_sqlite_add_pragma(struct md_writer_sqlite *mws,
+                                    const char *key, json_object *val)
+{
+    char value[32];
+    const char *str;
+    size_t i;
+
+    for (i = 0; i < MD_SQLITE_NUM_PRAGMAS; i++) {
+        if (!strcmp(key, md_sqlite_pragma_names[i]))
+            break;
+    }
+
+    if (i == MD_SQLITE_NUM_PRAGMAS) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Unknown SQLite pragma %s\n",
+                key);
+        return RETVAL_FAILURE;
+    }
+
+    if (json_object_is_type(val, json_type_int)) {
+        snprintf(value, sizeof(value), "%" PRId64, json_object_get_int64(val));
+        return md_sqlite_append_pragma(mws, key, value);
+    } else {
+        str = json_object_get_string(val);
+
+        for (i = 0; str[i]; i++) {
+            if (!isalnum((unsigned char) str[i]) && str[i] != '_') {
+                META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Invalid value for "
+                        "SQLite pragma %s\n", key);
+                return RETVAL_FAILURE;
+            }
+        }
+
+        if (!strcmp(key, "journal_mode") && !strcasecmp(str, "wal"))
+            mws->wal_checkpoint = 1;
+
+        return md_sqlite_append_pragma(mws, key, str);
+    }
+}
+
+static uint8_t md_sqlite_config_pragmas(struct md_writer_sqlite *mws,
+                                        json_object *pragmas)
+{
+    const char *mutex;
+    char value[32];
+    int32_t wal_frames = -1;
+
+    json_object_object_foreach(pragmas, key, val) {
+        //Only the writer's loop uses the handle, so the mutex is not needed.
+        //Default is still full, since that is what we have always used
+        if (!strcmp(key, "mutex")) {
+            mutex = json_object_get_string(val);
+
+            if (!strcmp(mutex, "full")) {
+                mws->mutex_flag = SQLITE_OPEN_FULLMUTEX;
+            } else if (!strcmp(mutex, "none")) {
+                mws->mutex_flag = SQLITE_OPEN_NOMUTEX;
+            } else {
+                META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Unknown SQLite mutex "
+                        "mode %s\n", mutex);
+                return RETVAL_FAILURE;
+            }
+        } else if (!strcmp(key, "wal_autocheckpoint")) {
+            //Applied below, since it depends on the journal mode
+            wal_frames = json_object_get_int(val);
+        } else if (md_sqlite_add_pragma(mws, key, val)) {
+            return RETVAL_FAILURE;
+        }
+    }
+
+    //With WAL, wal_autocheckpoint is used as the threshold for the idle
+    //checkpoint, see md_sqlite_wal_hook(). Otherwise it is passed on as is
+    if (mws->wal_checkpoint) {
+        if (wal_frames > 0)
+            mws->wal_frames = wal_frames;
+
+        if (md_sqlite_append_pragma(mws, "wal_autocheckpoint", "0"))
+            return RETVAL_FAILURE;
+    } else if (wal_frames >= 0) {
+        snprintf(value, sizeof(value), "%d", wal_frames);
+
+        if (md_sqlite_append_pragma(mws, "wal_autocheckpoint", value))
+            return RETVAL_FAILURE;
+    }
+
+    return RETVAL_SUCCESS;
+}
+
 void md_sqlite_usage()
 {
     fprintf(stderr, "\"sqlite\": {\t\tSQLite writer. At least one prefix is required.\n");
@@ -511,6 +778,20 @@ void md_sqlite_usage()
     fprintf(stderr, "  \"system_prefix\":\tlocation + filename prefix for system events (max 116 characters)\n");
     fprintf(stderr, "  \"interval\":\t\ttime (in ms) from event and until database is copied (default: 5 sec)\n");
     fprintf(stderr, "  \"events\":\t\tnumber of events before copying database (default: 10)\n");
+    fprintf(stderr, "  \"tx_interval\":\tmax time (in ms) events are kept in an open transaction (default: 0)\n");
+    fprintf(stderr, "  \"tx_events\":\t\tmax number of events in one transaction (default: 0)\n");
+    fprintf(stderr, "\t\t\tIf both are 0, the events handled in one wakeup are committed together\n");
+    fprintf(stderr, "  \"pragmas\": {\t\tSQLite tuning (default: SQLite defaults)\n");
+    fprintf(stderr, "    \"journal_mode\",\n");
+    fprintf(stderr, "    \"synchronous\",\n");
+    fprintf(stderr, "    \"mmap_size\",\n");
+    fprintf(stderr, "    \"cache_size\",\n");
+    fprintf(stderr, "    \"temp_store\",\n");
+    fprintf(stderr, "    \"wal_autocheckpoint\":\tset PRAGMA to value. With journal_mode wal, the WAL is\n");
+    fprintf(stderr, "\t\t\tcheckpointed when the writer is idle and the WAL has at least\n");
+    fprintf(stderr, "\t\t\twal_autocheckpoint pages (default: %u)\n", MD_SQLITE_WAL_FRAMES);
+    fprintf(stderr, "    \"mutex\":\t\tfull (default) or none\n");
+    fprintf(stderr, "  }\n");
     fprintf(stderr, "  \"session_id\":\t\tpath to session id file\n");
     fprintf(stderr, "  \"api_version\":\tbackend API version (default: 1)\n");
     fprintf(stderr, "  \"last_conn_tstamp_path\":\toptional path to file where we read/store timestamp of last conn dump\n");
@@ -522,11 +803,12 @@ int32_t md_sqlite_init(void *ptr, json_object* config)
 {
     struct md_writer_sqlite *mws = ptr;
     uint32_t node_id = 0, interval = DEFAULT_TIMEOUT, num_events = EVENT_LIMIT;
+    uint32_t tx_interval = 0, tx_events = 0;
     const char *db_filename = NULL, *meta_prefix = NULL, *gps_prefix = NULL,
                *monitor_prefix = NULL, *usage_prefix = NULL,
                *system_prefix = NULL, *ntp_fix_file = NULL;
 
-    json_object* subconfig;
+    json_object* subconfig, *pragmas = NULL;
     if (json_object_object_get_ex(config, "sqlite", &subconfig)) {
         json_object_object_foreach(subconfig, key, val) {
             if (!strcmp(key, "database"))
@@ -549,6 +831,12 @@ int32_t md_sqlite_init(void *ptr, json_object* config)
                 interval = ((uint32_t) json_object_get_int(val)) * 1000;
             else if (!strcmp(key, "events"))
                 num_events = (uint32_t) json_object_get_int(val);
+            else if (!strcmp(key, "tx_interval"))
+                tx_interval = (uint32_t) json_object_get_int(val);
+            else if (!strcmp(key, "tx_events"))
+                tx_events = (uint32_t) json_object_get_int(val);
+            else if (!strcmp(key, "pragmas"))
+                pragmas = val;
             else if (!strcmp(key, "session_id"))
                 mws->session_id_file = strdup(json_object_get_string(val));
             else if (!strcmp(key, "api_version"))
@@ -590,11 +878,17 @@ int32_t md_sqlite_init(void *ptr, json_object* config)
         return RETVAL_FAILURE;
     }
 
+    mws->mutex_flag = SQLITE_OPEN_FULLMUTEX;
+    mws->wal_frames = MD_SQLITE_WAL_FRAMES;
+
+    if (pragmas && md_sqlite_config_pragmas(mws, pragmas))
+        return RETVAL_FAILURE;
+
     META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Done configuring SQLite handle\n");
 
     return md_sqlite_configure(mws, db_filename, node_id, interval,
-            num_events, meta_prefix, gps_prefix, monitor_prefix, usage_prefix,
-            system_prefix, ntp_fix_file);
+            num_events, tx_interval, tx_events, meta_prefix, gps_prefix,
+            monitor_prefix, usage_prefix, system_prefix, ntp_fix_file);
 }
 
 static uint8_t md_sqlite_check_valid_tstamp(struct md_writer_sqlite *mws)
@@ -657,54 +951,52 @@ static uint8_t md_sqlite_check_session_id(struct md_writer_sqlite *mws)
     return RETVAL_SUCCESS;
 }
 
-static void md_sqlite_handle(struct md_writer *writer, struct md_event *event)
+static uint8_t md_sqlite_insert_event(struct md_writer_sqlite *mws,
+                                      struct md_event *event)
 {
     uint8_t retval = RETVAL_SUCCESS;
-    struct md_writer_sqlite *mws = (struct md_writer_sqlite*) writer;
 
     switch (event->md_type) {
     case META_TYPE_CONNECTION:
-        if (!mws->meta_prefix[0])
-            return;
-
         retval = md_inventory_handle_conn_event(mws, (struct md_conn_event*) event);
         break;
     case META_TYPE_POS:
-        if (!mws->gps_prefix[0])
-            return;
-
         retval = md_inventory_handle_gps_event(mws, (struct md_gps_event*) event);
         if (!retval)
             mws->num_gps_events++;
         break;
     case META_TYPE_MUNIN:
-        if (!mws->monitor_prefix[0])
-            return;
-
         retval = md_sqlite_handle_munin_event(mws, (struct md_munin_event*) event);
         if (!retval)
             mws->num_munin_events++;
         break;
     case META_TYPE_SYSTEM:
-        if (!mws->system_prefix[0])
-            return;
-
         retval = md_inventory_handle_system_event(mws, (md_system_event_t*) event);
 
         if (!retval)
             mws->num_system_events++;
         break;
     default:
-        META_PRINT_SYSLOG(mws->parent, LOG_INFO, "SQLite writer does not support event %u\n",
-                event->md_type);
-        return;
+        //Only subscribed types are passed to the writer
+        return RETVAL_FAILURE;
     }
 
-    if (retval == RETVAL_FAILURE) {
+    if (retval == RETVAL_FAILURE)
         META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed/ignored to insert JSON in DB\n");
-        return;
-    }
 
+    return retval;
+}
+
+static uint32_t md_sqlite_num_events(struct md_writer_sqlite *mws)
+{
+    return mws->num_conn_events + mws->num_gps_events + mws->num_munin_events +
+           mws->num_usage_events;
+}
+
+//Called after one or more events have been inserted, checks if the db should
+//be exported now or if the export timer should be started
+static void md_sqlite_check_export(struct md_writer_sqlite *mws)
+{
     //Something failed when dumping database, we have already rearmed timer for
     //checking again. So wait with trying new export etc. This also means that
     //we have a good timestamp
@@ -732,16 +1024,48 @@ static void md_sqlite_handle(struct md_writer *writer, struct md_event *event)
     //These two are exclusive. There is no point adding timeout if event_limit
     //is hit. This can happen if event_limit is 1. The reason we do not use
     //lte is that if a copy fails, we deal with that in a timeout
-    if ((mws->num_conn_events + mws->num_gps_events + mws->num_munin_events +
-                mws->num_usage_events) == mws->db_events) {
+    if (md_sqlite_num_events(mws) == mws->db_events) {
         md_sqlite_copy_db(mws, 0);
     } else if (!mws->timeout_added) {
-        mde_start_timer(mws->parent->event_loop, mws->timeout_handle,
+        mde_start_timer(mws->event_loop, mws->timeout_handle,
                         mws->db_interval);
         mws->timeout_added = 1;
     }
 }
 
+//Events are inserted in a transaction that is kept open until tx_events
+//events have been inserted, tx_interval ms have passed or the db is exported.
+//If neither threshold is set, the transaction covers one batch
+static void md_sqlite_handle(struct md_writer *writer, struct md_event *event)
+{
+    struct md_writer_sqlite *mws = (struct md_writer_sqlite*) writer;
+
+    md_sqlite_tx_begin(mws);
+
+    //Ignored events (for example duplicate GPS) can still trigger an export
+    if (md_sqlite_insert_event(mws, event) == RETVAL_FAILURE)
+        return;
+
+    if (mws->in_tx && mws->tx_events && ++mws->tx_pending >= mws->tx_events)
+        md_sqlite_tx_commit(mws);
+
+    md_sqlite_check_export(mws);
+}
+
+static void md_sqlite_handle_batch(struct md_writer *writer,
+                                   struct md_event **events,
+                                   uint32_t num_events)
+{
+    struct md_writer_sqlite *mws = (struct md_writer_sqlite*) writer;
+    uint32_t i;
+
+    for (i = 0; i < num_events; i++)
+        md_sqlite_handle(writer, events[i]);
+
+    if (!mws->tx_events && !mws->tx_interval)
+        md_sqlite_tx_commit(mws);
+}
+
 static void md_sqlite_handle_timeout(void *ptr)
 {
     struct md_writer_sqlite *mws = ptr;
@@ -802,7 +1126,7 @@ static void md_sqlite_handle_timeout(void *ptr)
     md_sqlite_copy_db(mws, 1);
 
     //If we get here, then timeout has been processed. If copy_db has failed,
-    //timeout will be started by the iteration callback. Intvl is set to 0 here
+    //timeout will be started by the retry task. Intvl is set to 0 here
     //to make sure that we reset interval
     mws->timeout_added = 0;
     mws->timeout_handle->intvl = 0;
@@ -812,7 +1136,7 @@ void md_sqlite_setup(struct md_exporter *mde, struct md_writer_sqlite* mws) {
     mws->parent = mde;
     mws->init = md_sqlite_init;
     mws->handle = md_sqlite_handle;
-    mws->itr_cb = md_sqlite_itr_cb;
+    mws->handle_batch = md_sqlite_handle_batch;
     mws->usage = md_sqlite_usage;
     mws->api_version = 1;
 }
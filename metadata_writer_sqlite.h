@@ -29,12 +29,15 @@
 #include <sys/time.h>
 #include <sqlite3.h>
 #include "metadata_exporter.h"
+#include "backend_event_loop.h"
 
 #define DEFAULT_TIMEOUT 5000
 #define TIMEOUT_FILE 1000
 #define EVENT_LIMIT 10
 #define MAX_PATH_LEN 128
 #define FAKE_UPDATE_LIMIT 120
+//WAL pages before the idle checkpoint, same as SQLite's wal_autocheckpoint
+#define MD_SQLITE_WAL_FRAMES 1000
 
 #define CREATE_SQL          "CREATE TABLE IF NOT EXISTS NetworkEvent(" \
                             "NodeId INTEGER NOT NULL," \
@@ -168,13 +171,12 @@
                             "BootMultiplier, Timestamp, Sequence, EventType, DeviceId)"\
                             "VALUES (?,?,?,?,?,16,?)"
 
-#define SELECT_LAST_UPDATE  "SELECT HasIp,Connectivity,ConnectionMode,Quality "\
-                            " FROM NetworkUpdates WHERE "\
-                            "L3SessionId=? AND "\
-                            "L4SessionId=? AND InterfaceId=? "\
-                            "AND SimCardIccid=? AND SimCardImsi=? "\
-                            "AND NetworkAddressFamily=? AND "\
-                            "NetworkAddress=? ORDER BY Timestamp DESC LIMIT 1;"
+//Used to fill the last update cache at startup. Ordered by timestamp, so that
+//the last update for a key is the one that is kept
+#define SELECT_LAST_UPDATES "SELECT L3SessionId,L4SessionId,InterfaceId,"\
+                            "SimCardIccid,SimCardImsi,NetworkAddressFamily,"\
+                            "NetworkAddress,ConnectionMode,Quality,Timestamp "\
+                            "FROM NetworkUpdates ORDER BY Timestamp"
 
 //The reason NetworkAddress is used here, is that we first identify by L3/L4
 //session. However, it might be that multiple addresses on same interface has
@@ -198,6 +200,27 @@
                             "WHERE " \
                             "DeviceId=? AND NetworkAddressFamily=? AND SimCardIccid=? AND SimCardImsi=? AND Timestamp=?"
 
+//UPSERT (SQLite >= 3.24) versions of INSERT_UPDATE/UPDATE_UPDATE and
+//INSERT_USAGE/UPDATE_USAGE. Parameters are the same as for the INSERTs. The
+//conflict targets are the primary keys of the tables
+#define UPSERT_SQLITE_VERSION   3024000
+
+#define UPSERT_UPDATE       INSERT_UPDATE \
+                            " ON CONFLICT(SessionId,SessionIdMultip," \
+                            "SimCardIccid,SimCardImsi,L3SessionId,L4SessionId," \
+                            "InterfaceId,NetworkAddressFamily,NetworkAddress) " \
+                            "DO UPDATE SET Timestamp=excluded.Timestamp," \
+                            "HasIp=excluded.HasIp,Connectivity=excluded.Connectivity," \
+                            "ConnectionMode=excluded.ConnectionMode," \
+                            "Quality=excluded.Quality," \
+                            "EventValueStr=excluded.EventValueStr"
+
+#define UPSERT_USAGE        INSERT_USAGE \
+                            " ON CONFLICT(DeviceId,NetworkAddressFamily," \
+                            "SimCardIccid,SimCardImsi,Timestamp) " \
+                            "DO UPDATE SET RxData=RxData+excluded.RxData," \
+                            "TxData=TxData+excluded.TxData"
+
 #define UPDATE_EVENT_ID     "UPDATE NetworkEvent SET " \
                             "NodeId=? "\
                             "WHERE NodeId=0"
@@ -279,6 +302,7 @@
 struct md_event;
 struct md_writer;
 struct backend_timeout_handle;
+struct md_inventory_update;
 
 struct md_writer_sqlite {
     MD_WRITER;
@@ -306,7 +330,9 @@ struct md_writer_sqlite {
     sqlite3_stmt *insert_event, *insert_update;
     sqlite3_stmt *update_update, *dump_update;
     sqlite3_stmt *delete_table, *dump_table;
-    sqlite3_stmt *last_update;
+    //Mode/quality of the last update per session, see
+    //metadata_writer_inventory_conn.h
+    struct md_inventory_update **last_updates;
 
     sqlite3_stmt *insert_gps, *delete_gps, *dump_gps;
     sqlite3_stmt *insert_monitor, *delete_monitor, *dump_monitor;
@@ -319,21 +345,44 @@ struct md_writer_sqlite {
     char *node_id_file;
     const char *last_conn_tstamp_path;
     struct backend_timeout_handle *timeout_handle;
+    //Commits the open transaction after tx_interval ms
+    struct backend_timeout_handle *tx_timeout_handle;
+    //Starts the export timer again after a failed DB dump
+    struct backend_task retry_task;
+    //Checkpoints the WAL when the loop is idle
+    struct backend_task checkpoint_task;
     struct timeval first_fake_update;
 
     uint32_t node_id;
     uint32_t db_interval;
     uint32_t db_events;
+    //Commit thresholds, 0 means not used
+    uint32_t tx_interval;
+    uint32_t tx_events;
+    //Events inserted in the open transaction
+    uint32_t tx_pending;
     uint32_t num_conn_events;
     uint32_t num_gps_events;
     uint32_t num_munin_events;
     uint32_t num_usage_events;
     uint32_t num_system_events;
+    //WAL size (in pages) that triggers the idle checkpoint
+    uint32_t wal_frames;
 
     uint8_t timeout_added;
+    uint8_t in_tx;
     uint8_t file_failed;
     uint8_t do_fake_updates;
     uint8_t valid_timestamp;
+    uint8_t wal_checkpoint;
+    //insert_update/insert_usage are UPSERTs, update_update/update_usage are
+    //not used
+    uint8_t use_upsert;
+
+    //SQLITE_OPEN_FULLMUTEX or SQLITE_OPEN_NOMUTEX
+    int mutex_flag;
+    //PRAGMA statements run when the database is opened
+    char pragmas[512];
 
     char meta_prefix[128], gps_prefix[128], monitor_prefix[128],
         usage_prefix[128], system_prefix[128], ntp_fix_file[128];
@@ -70,7 +70,13 @@ uint8_t md_writer_helpers_copy_db(char *prefix, size_t prefix_len,
         return RETVAL_FAILURE;
     }
 
-    fclose(output);
+    //Rows are streamed to the file, so the last write happens here
+    if (fclose(output)) {
+        META_PRINT_SYSLOG(mws->parent, LOG_ERR, "Failed to write dump-file: %s\n", strerror(errno));
+        remove(prefix);
+        return RETVAL_FAILURE;
+    }
+
     META_PRINT_SYSLOG(mws->parent, LOG_INFO, "Done with tmpfile %s\n", dst_filename);
 
     if (link(prefix, dst_filename) ||
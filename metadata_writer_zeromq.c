@@ -40,6 +40,7 @@
 #include "lib/minmea.h"
 #include "metadata_exporter.h"
 #include "metadata_writer_zeromq.h"
+#include "metadata_event.h"
 #include "system_helpers.h"
 #include "metadata_utils.h"
 #include "metadata_exporter_log.h"
@@ -108,7 +109,8 @@ static json_object *md_zeromq_writer_create_json_double(json_object *obj,
 }
 
 static uint8_t md_zeromq_writer_add_default_fields(const struct md_writer_zeromq *mwz,
-        struct json_object* obj, int seq, int64_t tstamp, const char* dataid) {
+        struct json_object* obj, int seq, int64_t tstamp, const char* dataid,
+        const char* origin) {
     if (!md_zeromq_writer_create_json_int(obj, mwz->keys[MD_ZMQ_KEY_SEQ],
             seq)) {
       return 0;
@@ -132,6 +134,13 @@ static uint8_t md_zeromq_writer_add_default_fields(const struct md_writer_zeromq
         return 0;
     }
 
+    //Only set for events received from a fan-in node
+    if (origin && mwz->keys[MD_ZMQ_KEY_ORIGIN] &&
+        !md_zeromq_writer_create_json_string(obj, mwz->keys[MD_ZMQ_KEY_ORIGIN],
+            origin)) {
+        return 0;
+    }
+
     return 1;
 }
 
@@ -145,7 +154,8 @@ static json_object* md_zeromq_writer_create_json_gps(struct md_writer_zeromq *mw
 
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, mge->sequence,
-            mge->tstamp_tv.tv_sec, mwz->topics[MD_ZMQ_TOPIC_GPS])) {
+            mge->tstamp_tv.tv_sec, mwz->topics[MD_ZMQ_TOPIC_GPS],
+            md_event_get_origin((struct md_event*) mge))) {
         json_object_put(obj);
         return NULL;
     }
@@ -208,7 +218,9 @@ static void md_zeromq_writer_handle_munin(struct md_writer_zeromq *mwz,
     int retval;
 
     json_object_object_foreach(mge->json_blob, key, val) {
-        md_zeromq_writer_add_default_fields(mwz, val, mge->sequence, mge->tstamp, mwz->topics[MD_ZMQ_TOPIC_SENSOR]);
+        md_zeromq_writer_add_default_fields(mwz, val, mge->sequence, mge->tstamp,
+                mwz->topics[MD_ZMQ_TOPIC_SENSOR],
+                md_event_get_origin((struct md_event*) mge));
 
         retval = snprintf(topic, sizeof(topic), "%s.%s %s",
                 mwz->topics[MD_ZMQ_TOPIC_SENSOR],
@@ -227,7 +239,8 @@ static void md_zeromq_writer_handle_sysevent(struct md_writer_zeromq *mwz,
     int retval;
 
     md_zeromq_writer_add_default_fields(mwz, mge->json_blob, mge->sequence,
-        mge->tstamp, mwz->topics[MD_ZMQ_TOPIC_SYSEVENT]);
+        mge->tstamp, mwz->topics[MD_ZMQ_TOPIC_SYSEVENT],
+        md_event_get_origin((struct md_event*) mge));
 
     retval = snprintf(topic, sizeof(topic), "%s %s",
             mwz->topics[MD_ZMQ_TOPIC_SYSEVENT],
@@ -248,7 +261,8 @@ static json_object* md_zeromq_writer_create_json_modem_default(struct md_writer_
         return NULL;
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, mce->sequence, mce->tstamp,
-            mwz->topics[MD_ZMQ_TOPIC_CONNECTIVITY])) {
+            mwz->topics[MD_ZMQ_TOPIC_CONNECTIVITY],
+            md_event_get_origin((struct md_event*) mce))) {
         json_object_put(obj);
         return NULL;
     }
@@ -367,7 +381,8 @@ static json_object *md_zeromq_writer_create_iface_json(const struct md_writer_ze
         return NULL;
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, mie->sequence, mie->tstamp,
-            mwz->topics[MD_ZMQ_TOPIC_MODEM])) {
+            mwz->topics[MD_ZMQ_TOPIC_MODEM],
+            md_event_get_origin((struct md_event*) mie))) {
         json_object_put(obj);
         return NULL;
     }
@@ -555,7 +570,8 @@ static json_object *md_zeromq_writer_handle_radio_cell_loc_gerant(
         return NULL;
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, event->sequence,
-            event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_CELL_LOCATION_GERAN])) {
+            event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_CELL_LOCATION_GERAN],
+            md_event_get_origin((struct md_event*) event))) {
         json_object_put(obj);
         return NULL;
     }
@@ -648,7 +664,8 @@ static json_object *md_zeromq_writer_handle_radio_cell_resel_event(
     }
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, event->sequence,
-        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GRR_CELL_RESEL])) {
+        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GRR_CELL_RESEL],
+            md_event_get_origin((struct md_event*) event))) {
         json_object_put(obj);
         return NULL;
     }
@@ -736,7 +753,8 @@ static json_object *md_zeromq_writer_handle_radio_cipher_mode_event(
     }
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, event->sequence,
-        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CIPHER_MODE])) {
+        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CIPHER_MODE],
+            md_event_get_origin((struct md_event*) event))) {
         json_object_put(obj);
         return NULL;
     }
@@ -785,7 +803,8 @@ static json_object *md_zeromq_writer_handle_cell_reset_param_event(
     } 
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, event->sequence,
-        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CELL_SEL_RESEL_PARAM])) {
+        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CELL_SEL_RESEL_PARAM],
+            md_event_get_origin((struct md_event*) event))) {
         json_object_put(obj);
         return NULL;
     }
@@ -864,7 +883,8 @@ static json_object *md_zeromq_writer_handle_rr_channel_conf_event(
     }
 
     if (!md_zeromq_writer_add_default_fields(mwz, obj, event->sequence,
-        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CHANNEL_CONF])) {
+        event->tstamp, mwz->topics[MD_ZMQ_TOPIC_RADIO_GSM_RR_CHANNEL_CONF],
+            md_event_get_origin((struct md_event*) event))) {
         json_object_put(obj);
         return NULL;
     }
@@ -971,10 +991,7 @@ static void md_zeromq_writer_handle_radio(struct md_writer_zeromq *mwz,
                 (struct md_radio_grr_cell_resel_event*) mre);
         break;
     default:
-        META_PRINT_SYSLOG(mwz->parent, LOG_INFO, "ZMQ writer does not support event %u\n",
-                                    mre->md_type);  
-        break;
-
+        return;
     }
 
     if (!obj) {
@@ -997,13 +1014,10 @@ static void md_zeromq_writer_handle(struct md_writer *writer, struct md_event *e
 {
     struct md_writer_zeromq *mwz = (struct md_writer_zeromq*) writer;
 
-    if (!mwz->socket_bound) {
+    //The bind timer is kept after the socket has been bound, the loop keeps a
+    //reference to it for dumping stats
+    if (!mwz->socket_bound)
         return;
-    } else if (mwz->bind_timeout_handle != NULL) {
-        //todo: stop doing this check on every iteration, add proper callback
-        free(mwz->bind_timeout_handle);
-        mwz->bind_timeout_handle = NULL;
-    }
 
     switch (event->md_type) {
     case META_TYPE_POS:
@@ -1025,8 +1039,6 @@ static void md_zeromq_writer_handle(struct md_writer *writer, struct md_event *e
         md_zeromq_writer_handle_radio(mwz, (struct md_radio_event*) event);
         break;
     default:
-        META_PRINT_SYSLOG(mwz->parent, LOG_INFO, "ZMQ writer does not support event %u\n",
-                                    event->md_type);  
         break;
     }
 }
@@ -1039,11 +1051,11 @@ static void md_zeromq_writer_bind_timeout(void *ptr)
     if ((retval = zmq_bind(mwz->zmq_publisher, mwz->zmq_addr)) != 0) {
         META_PRINT_SYSLOG(mwz->parent, LOG_ERR, "zmq_bind failed (%d): %s, "
                 "stating timer\n", errno, zmq_strerror(errno));
-        mwz->bind_timeout_handle->intvl = MD_ZMQ_BIND_INTVL;
+        mde_start_timer(mwz->event_loop, mwz->bind_timeout_handle,
+                MD_ZMQ_BIND_INTVL);
     } else {
         META_PRINT_SYSLOG(mwz->parent, LOG_INFO, "zmq_bind succeeded after "
                 "timeout\n");
-        mwz->bind_timeout_handle->intvl = 0;
         mwz->socket_bound = 1;
     }
 
@@ -1074,7 +1086,9 @@ static uint8_t md_zeromq_writer_config(struct md_writer_zeromq *mwz,
             return RETVAL_FAILURE;
         }
 
-        mde_start_timer(mwz->parent->event_loop, mwz->bind_timeout_handle,
+        mwz->bind_timeout_handle->name = "zmq bind";
+        mwz->bind_timeout_handle->slack = MD_ZMQ_BIND_SLACK;
+        mde_start_timer(mwz->event_loop, mwz->bind_timeout_handle,
                 MD_ZMQ_BIND_INTVL);
     } else {
         mwz->socket_bound = 1;
@@ -1130,6 +1144,24 @@ static int32_t md_zeromq_writer_init(void *ptr, json_object* config)
         return RETVAL_FAILURE;
     }
 
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_POS,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_CONNECTION,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_MUNIN,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_SYSEVENT,
+            MD_EVENT_PARAM_ALL);
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_INTERFACE,
+            MD_EVENT_PARAM_ALL);
+    //WCDMA events are not exported
+    mde_writer_subscribe((struct md_writer*) mwz, META_TYPE_RADIO,
+            MD_EVENT_PARAM(RADIO_EVENT_GSM_RR_CIPHER_MODE) |
+            MD_EVENT_PARAM(RADIO_EVENT_GSM_RR_CHANNEL_CONF) |
+            MD_EVENT_PARAM(RADIO_EVENT_CELL_LOCATION_GERAN) |
+            MD_EVENT_PARAM(RADIO_EVENT_GSM_RR_CELL_SEL_RESEL_PARAM) |
+            MD_EVENT_PARAM(RADIO_EVENT_GRR_CELL_RESEL));
+
     return md_zeromq_writer_config(mwz, address, port);
 }
 
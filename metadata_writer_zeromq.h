@@ -31,6 +31,7 @@
 #include "metadata_exporter.h"
 
 #define MD_ZMQ_BIND_INTVL   1000
+#define MD_ZMQ_BIND_SLACK   500
 #define MD_ZMQ_DATA_VERSION 3
 
 enum md_zmq_topics {
@@ -151,6 +152,7 @@ enum md_zmq_keys {
     MD_ZMQ_KEY_RADIO_CHANNEL_MODE_2,
 
     MD_ZMQ_KEY_MONROE_IIF_NAME,
+    MD_ZMQ_KEY_ORIGIN,
     __MD_ZMQ_KEYS_MAX
 };
 #define MD_ZMQ_KEYS_MAX (__MD_ZMQ_KEYS_MAX - 1)
@@ -113,5 +113,6 @@ const char *monroe_keys[MD_ZMQ_KEYS_MAX + 1] = {
     "ChannelMode1",
     "ChannelMode2",
 
-    "InternalInterface"
+    "InternalInterface",
+    "Origin"
 };
@@ -115,5 +115,6 @@ const char *nne_keys[MD_ZMQ_KEYS_MAX + 1] = {
     "channel_mode_1",
     "channel_mode_2",
 
-    NULL
+    NULL,
+    "origin"
 };